@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * affinity.c - CPU topology discovery and worker placement for yogini
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <err.h>
+#include <sched.h>
+#include "yogini.h"
+
+enum {
+	CPU_POLICY_NONE = 0,
+	CPU_POLICY_LIST,	/* explicit cpulist, e.g. "0-3,8" */
+	CPU_POLICY_COMPACT,	/* fill a package, one thread per core, then siblings */
+	CPU_POLICY_SCATTER,	/* round-robin across packages */
+	CPU_POLICY_CORE,	/* one thread per physical core only */
+	CPU_POLICY_SMT,		/* consecutive workers share a core */
+};
+
+static int cpu_policy = CPU_POLICY_NONE;
+static int *cpu_list;
+static int cpu_list_len;
+
+struct cpu_topology *cpu_topo;
+int topo_num_cpus;
+
+static int read_sysfs_int(const char *fmt, int cpu)
+{
+	char path[128];
+	FILE *fp;
+	int val;
+
+	snprintf(path, sizeof(path), fmt, cpu);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (fscanf(fp, "%d", &val) != 1)
+		val = -1;
+	fclose(fp);
+
+	return val;
+}
+
+/*
+ * parse_cpulist()
+ * parse the kernel cpulist format, e.g. "0-3,8,10-11"
+ * return the number of CPUs stored in *cpus, or -1 on malformed input
+ */
+int parse_cpulist(const char *str, int **cpus)
+{
+	const char *p = str;
+	int *list = NULL;
+	int num = 0;
+
+	while (*p) {
+		char *end;
+		long first, last, i;
+
+		if (!isdigit((unsigned char)*p))
+			goto bad;
+		first = strtol(p, &end, 10);
+		last = first;
+		p = end;
+		if (*p == '-') {
+			p++;
+			if (!isdigit((unsigned char)*p))
+				goto bad;
+			last = strtol(p, &end, 10);
+			p = end;
+		}
+		if (last < first || last >= CPU_SETSIZE)
+			goto bad;
+
+		list = realloc(list, sizeof(int) * (num + last - first + 1));
+		if (!list)
+			err(1, "cpulist");
+		for (i = first; i <= last; i++)
+			list[num++] = i;
+
+		if (*p == ',')
+			p++;
+		else if (*p && !isspace((unsigned char)*p))
+			goto bad;
+		else
+			break;
+	}
+
+	if (num == 0)
+		goto bad;
+
+	*cpus = list;
+	return num;
+bad:
+	free(list);
+	return -1;
+}
+
+/*
+ * discover_cpu_topology()
+ * fill cpu_topo[] with every CPU this process may run on
+ */
+void discover_cpu_topology(void)
+{
+	cpu_set_t allowed;
+	int cpu, i, j;
+
+	if (cpu_topo)
+		return;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		err(1, "sched_getaffinity");
+
+	cpu_topo = calloc(CPU_COUNT(&allowed), sizeof(struct cpu_topology));
+	if (!cpu_topo)
+		err(1, "cpu_topology");
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		struct cpu_topology *t;
+
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+
+		t = &cpu_topo[topo_num_cpus++];
+		t->cpu = cpu;
+		t->package = read_sysfs_int("/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+		t->core = read_sysfs_int("/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+		/* without sysfs, treat every CPU as its own core */
+		if (t->package < 0)
+			t->package = 0;
+		if (t->core < 0)
+			t->core = cpu;
+	}
+
+	/* smt: rank of this CPU among its core siblings */
+	for (i = 0; i < topo_num_cpus; i++) {
+		struct cpu_topology *t = &cpu_topo[i];
+
+		for (j = 0; j < i; j++) {
+			struct cpu_topology *o = &cpu_topo[j];
+
+			if (o->package == t->package && o->core == t->core)
+				t->smt++;
+		}
+	}
+
+	/* core_idx: rank of this core among the cores of its package */
+	for (i = 0; i < topo_num_cpus; i++) {
+		struct cpu_topology *t = &cpu_topo[i];
+
+		for (j = 0; j < topo_num_cpus; j++) {
+			struct cpu_topology *o = &cpu_topo[j];
+
+			if (o->package == t->package && o->smt == 0 && o->core < t->core)
+				t->core_idx++;
+		}
+	}
+}
+
+int parse_cpus_cmd(char *input_string)
+{
+	if (strcmp(input_string, "compact") == 0) {
+		cpu_policy = CPU_POLICY_COMPACT;
+	} else if (strcmp(input_string, "scatter") == 0) {
+		cpu_policy = CPU_POLICY_SCATTER;
+	} else if (strcmp(input_string, "core") == 0) {
+		cpu_policy = CPU_POLICY_CORE;
+	} else if (strcmp(input_string, "smt") == 0) {
+		cpu_policy = CPU_POLICY_SMT;
+	} else {
+		cpu_list_len = parse_cpulist(input_string, &cpu_list);
+		if (cpu_list_len < 0)
+			return -1;
+		cpu_policy = CPU_POLICY_LIST;
+	}
+	return 0;
+}
+
+static void policy_key(const struct cpu_topology *t, int key[3])
+{
+	switch (cpu_policy) {
+	case CPU_POLICY_SCATTER:
+		key[0] = t->smt;
+		key[1] = t->core_idx;
+		key[2] = t->package;
+		break;
+	case CPU_POLICY_SMT:
+		key[0] = t->package;
+		key[1] = t->core_idx;
+		key[2] = t->smt;
+		break;
+	case CPU_POLICY_COMPACT:
+	case CPU_POLICY_CORE:
+	default:
+		key[0] = t->package;
+		key[1] = t->smt;
+		key[2] = t->core_idx;
+		break;
+	}
+}
+
+static int compare_policy(const void *a, const void *b)
+{
+	int ka[3], kb[3];
+	int i;
+
+	policy_key(a, ka);
+	policy_key(b, kb);
+
+	for (i = 0; i < 3; i++) {
+		if (ka[i] != kb[i])
+			return ka[i] - kb[i];
+	}
+	return ((const struct cpu_topology *)a)->cpu - ((const struct cpu_topology *)b)->cpu;
+}
+
+/*
+ * policy_cpus()
+ * the CPUs --cpus selects, in the order workers are placed on them
+ * return how many are stored in *cpus, to be freed by the caller,
+ * 0 without --cpus
+ */
+int policy_cpus(int **cpus)
+{
+	struct cpu_topology *order;
+	int num = 0;
+	int i;
+
+	*cpus = NULL;
+	if (cpu_policy == CPU_POLICY_NONE)
+		return 0;
+
+	if (cpu_policy == CPU_POLICY_LIST) {
+		cpu_set_t allowed;
+
+		if (sched_getaffinity(0, sizeof(allowed), &allowed))
+			err(1, "sched_getaffinity");
+		for (i = 0; i < cpu_list_len; i++) {
+			if (!CPU_ISSET(cpu_list[i], &allowed))
+				errx(1, "CPU %d is not available", cpu_list[i]);
+		}
+		*cpus = malloc(sizeof(int) * cpu_list_len);
+		if (!*cpus)
+			err(1, "cpu order");
+		memcpy(*cpus, cpu_list, sizeof(int) * cpu_list_len);
+		num = cpu_list_len;
+	} else {
+		discover_cpu_topology();
+
+		order = malloc(sizeof(struct cpu_topology) * topo_num_cpus);
+		*cpus = malloc(sizeof(int) * topo_num_cpus);
+		if (!order || !*cpus)
+			err(1, "cpu order");
+
+		memcpy(order, cpu_topo, sizeof(struct cpu_topology) * topo_num_cpus);
+		qsort(order, topo_num_cpus, sizeof(struct cpu_topology), compare_policy);
+
+		for (i = 0; i < topo_num_cpus; i++) {
+			if (cpu_policy == CPU_POLICY_CORE && order[i].smt)
+				continue;
+			(*cpus)[num++] = order[i].cpu;
+		}
+		free(order);
+	}
+
+	return num;
+}
+
+/*
+ * smt_sibling_pair()
+ * the first --cpus CPU, or available CPU, that has an available
+ * SMT sibling in its thread_siblings_list, and that sibling
+ * return 0, or -1 if there is no such pair
+ */
+int smt_sibling_pair(int pair[2])
+{
+	cpu_set_t allowed;
+	char path[128], buf[256];
+	int *cands, *sibs;
+	int num, num_sibs;
+	int i, j, cpu;
+	FILE *fp;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		err(1, "sched_getaffinity");
+
+	num = policy_cpus(&cands);
+	if (!num) {
+		cands = malloc(sizeof(int) * CPU_COUNT(&allowed));
+		if (!cands)
+			err(1, "cpu pair");
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &allowed))
+				cands[num++] = cpu;
+	}
+
+	for (i = 0; i < num; i++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cands[i]);
+		fp = fopen(path, "r");
+		if (!fp)
+			continue;
+		if (!fgets(buf, sizeof(buf), fp))
+			buf[0] = '\0';
+		fclose(fp);
+
+		num_sibs = parse_cpulist(buf, &sibs);
+		for (j = 0; j < num_sibs; j++) {
+			if (sibs[j] == cands[i] || !CPU_ISSET(sibs[j], &allowed))
+				continue;
+			pair[0] = cands[i];
+			pair[1] = sibs[j];
+			free(sibs);
+			free(cands);
+			return 0;
+		}
+		if (num_sibs > 0)
+			free(sibs);
+	}
+
+	free(cands);
+	return -1;
+}
+
+/*
+ * bind_workers_to_cpus()
+ * assign wi->cpu for every worker according to --cpus,
+ * wrapping around when there are more workers than CPUs
+ */
+void bind_workers_to_cpus(struct work_instance *first)
+{
+	struct work_instance *wi;
+	int *cpus;
+	int num;
+	int i;
+
+	num = policy_cpus(&cpus);
+	if (!num)
+		return;
+
+	for (wi = first, i = 0; wi; wi = wi->next, i++)
+		wi->cpu = cpus[i % num];
+
+	free(cpus);
+}
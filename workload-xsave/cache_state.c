@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * cache_state.c - put a worker's working set in a known cache state
+ *
+ * Workloads register their buffers with cache_state_add() at init.
+ * run() calls cache_state_apply() before each work() pass, and the TSC
+ * cycles it takes are kept in wi->cache_cycles, outside the timed region:
+ *   hot:  nothing, the working set stays wherever the last pass left it
+ *   llc:  CLDEMOTE every line, so the pass starts from the LLC
+ *   cold: CLFLUSHOPT (or CLFLUSH) every line, then one SFENCE,
+ *         so the pass starts from memory
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <err.h>
+#include <immintrin.h>
+#include "yogini.h"
+
+#define CACHE_LINE	64
+
+int cache_mode = CACHE_HOT;
+
+static char *cache_mode_names[] = {
+	[CACHE_HOT] = "hot",
+	[CACHE_LLC] = "llc",
+	[CACHE_COLD] = "cold",
+};
+
+int parse_cache_cmd(char *input_string)
+{
+	int i;
+
+	for (i = CACHE_HOT; i <= CACHE_COLD; i++) {
+		if (strcmp(input_string, cache_mode_names[i]) == 0) {
+			cache_mode = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+char *cache_mode_name(int mode)
+{
+	return cache_mode_names[mode];
+}
+
+/* check cache_mode against CPUID, after both are known */
+void cache_mode_check(void)
+{
+	if (cache_mode == CACHE_LLC && !cpuid.cldemote)
+		errx(1, "cache llc: CLDEMOTE is not supported");
+}
+
+void cache_state_add(struct work_instance *wi, void *ptr, size_t bytes)
+{
+	if (wi->num_cache_ranges >= CACHE_MAX_RANGES)
+		errx(1, "%s: more than %d cache ranges", wi->workload->name, CACHE_MAX_RANGES);
+
+	wi->cache_ranges[wi->num_cache_ranges].ptr = ptr;
+	wi->cache_ranges[wi->num_cache_ranges].bytes = bytes;
+	wi->num_cache_ranges++;
+}
+
+__attribute__((target("cldemote")))
+static void demote_range(char *p, size_t bytes)
+{
+	char *end = p + bytes;
+
+	for (p = (char *)((uintptr_t)p & ~(CACHE_LINE - 1UL)); p < end; p += CACHE_LINE)
+		_cldemote(p);
+}
+
+__attribute__((target("clflushopt")))
+static void flushopt_range(char *p, size_t bytes)
+{
+	char *end = p + bytes;
+
+	for (p = (char *)((uintptr_t)p & ~(CACHE_LINE - 1UL)); p < end; p += CACHE_LINE)
+		_mm_clflushopt(p);
+}
+
+static void flush_range(char *p, size_t bytes)
+{
+	char *end = p + bytes;
+
+	for (p = (char *)((uintptr_t)p & ~(CACHE_LINE - 1UL)); p < end; p += CACHE_LINE)
+		_mm_clflush(p);
+}
+
+/*
+ * cache_state_apply()
+ * put wi's registered buffers in the cache_mode state,
+ * and add the cycles spent to wi->cache_cycles
+ */
+void cache_state_apply(struct work_instance *wi)
+{
+	unsigned long long tsc = rdtsc();
+	int i;
+
+	for (i = 0; i < wi->num_cache_ranges; i++) {
+		struct cache_range *cr = &wi->cache_ranges[i];
+
+		if (cache_mode == CACHE_LLC)
+			demote_range(cr->ptr, cr->bytes);
+		else if (cpuid.clflushopt)
+			flushopt_range(cr->ptr, cr->bytes);
+		else
+			flush_range(cr->ptr, cr->bytes);
+	}
+	/* CLFLUSHOPT and CLDEMOTE are only ordered by a fence */
+	_mm_sfence();
+
+	wi->cache_cycles += rdtsc() - tsc;
+}
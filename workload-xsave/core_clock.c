@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * core_clock.c - sustained core clock of each worker
+ *
+ * Every rate yogini reports is per TSC cycle, which hides frequency
+ * changes, e.g. the AVX-512 license. Each worker counts its own unhalted
+ * core and reference cycles across run() with perf_event_open(2): the
+ * architectural events if the PMU is visible, else APERF and MPERF from
+ * the "msr" PMU. Reference cycles tick at the TSC rate only while the
+ * thread runs, so core over reference cycles is its clock while running,
+ * not lowered by halts or time descheduled in a break.
+ * Where they are not available, e.g. in many VMs, nothing is reported.
+ * The cycles counter leads the worker's group in counters.c.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "yogini.h"
+
+#define MSR_PMU	"/sys/bus/event_source/devices/msr/"
+
+/* a counter on this thread, in group, or leading a new one if group is -1 */
+int perf_open(unsigned int type, unsigned long long config, int group)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	/* members follow the leader, which is enabled around run() */
+	attr.disabled = group < 0;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+			   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	/* this thread, on any CPU */
+	return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+/* the "msr" PMU type and its event name, e.g. aperf, from sysfs */
+static int msr_event(char *name, unsigned int *type, unsigned long long *config)
+{
+	char path[128];
+	FILE *fp;
+	int n;
+
+	fp = fopen(MSR_PMU "type", "r");
+	if (!fp)
+		return -1;
+	n = fscanf(fp, "%u", type);
+	fclose(fp);
+	if (n != 1)
+		return -1;
+
+	snprintf(path, sizeof(path), MSR_PMU "events/%s", name);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	n = fscanf(fp, "event=%llx", config);
+	fclose(fp);
+
+	return n == 1 ? 0 : -1;
+}
+
+/* open this worker's core cycles counter in group, return the fd or -1 */
+int core_clock_open(int group)
+{
+	unsigned long long config;
+	unsigned int type;
+	int fd;
+
+	fd = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, group);
+	if (fd < 0 && msr_event("aperf", &type, &config) == 0)
+		fd = perf_open(type, config, group);
+	return fd;
+}
+
+/* and its reference cycles counter */
+int ref_clock_open(int group)
+{
+	unsigned long long config;
+	unsigned int type;
+	int fd;
+
+	fd = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES, group);
+	if (fd < 0 && msr_event("mperf", &type, &config) == 0)
+		fd = perf_open(type, config, group);
+	return fd;
+}
+
+/* average core MHz while running in run(), 0 if not counted */
+double core_clock_mhz(struct work_instance *wi)
+{
+	if (!counted(wi, CTR_CYCLES) || !counted(wi, CTR_REF_CYCLES) || !wi->ctr[CTR_REF_CYCLES])
+		return 0;
+
+	return (double)wi->ctr[CTR_CYCLES] / wi->ctr[CTR_REF_CYCLES] * tsc_per_sec / 1e6;
+}
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * counters.c - per-worker perf_event counters around run()
+ *
+ * Every rate yogini reports is per TSC cycle, which hides frequency
+ * changes, e.g. the AVX-512 license, and everything else the core did.
+ * Each worker opens one perf_event_open(2) group on itself, enabled and
+ * read as a unit around run(), so all counters cover the same interval:
+ *   cycles:       unhalted core cycles, or APERF, see core_clock.c
+ *   ref_cycles:   reference cycles, or MPERF, see core_clock.c
+ *   instructions: architectural event
+ *   switches:     context switches, a software event, always available
+ *   fp_arith:     FP_ARITH_INST_RETIRED, all widths, on Intel only
+ *   amx_ops:      AMX_OPS_RETIRED, on Intel with AMX only
+ * Any counter that does not open is left out, and nothing derived from
+ * it is reported. When the PMU multiplexes, counts are scaled by
+ * time_enabled / time_running.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <cpuid.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include "yogini.h"
+
+/* raw Intel events, umask << 8 | event */
+#define INTEL_FP_ARITH_INST_RETIRED_ALL	0xFFC7
+#define INTEL_AMX_OPS_RETIRED_ALL	0x03CE
+
+char *counter_names[NUM_COUNTERS] = {
+	[CTR_CYCLES] = "cycles",
+	[CTR_INSTRUCTIONS] = "instructions",
+	[CTR_REF_CYCLES] = "ref_cycles",
+	[CTR_SWITCHES] = "switches",
+	[CTR_FP_ARITH] = "fp_arith",
+	[CTR_AMX_OPS] = "amx_ops",
+};
+
+static int is_intel(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	__cpuid(0, eax, ebx, ecx, edx);
+	return ebx == signature_INTEL_ebx && ecx == signature_INTEL_ecx &&
+	       edx == signature_INTEL_edx;
+}
+
+/* open counter ctr in group, -1 for a new group, return the fd or -1 */
+static int counter_open(int ctr, int group)
+{
+	switch (ctr) {
+	case CTR_CYCLES:
+		return core_clock_open(group);
+	case CTR_INSTRUCTIONS:
+		return perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, group);
+	case CTR_REF_CYCLES:
+		return ref_clock_open(group);
+	case CTR_SWITCHES:
+		return perf_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, group);
+	case CTR_FP_ARITH:
+		if (!is_intel())
+			return -1;
+		return perf_open(PERF_TYPE_RAW, INTEL_FP_ARITH_INST_RETIRED_ALL, group);
+	case CTR_AMX_OPS:
+		if (!is_intel() || !cpuid.amx_tile)
+			return -1;
+		return perf_open(PERF_TYPE_RAW, INTEL_AMX_OPS_RETIRED_ALL, group);
+	}
+	return -1;
+}
+
+/* open this worker's group, before the start barrier */
+void counters_open(struct work_instance *wi)
+{
+	int i;
+
+	wi->ctr_group = -1;
+	wi->ctr_mask = 0;
+	memset(wi->ctr, 0, sizeof(wi->ctr));
+
+	for (i = 0; i < NUM_COUNTERS; i++) {
+		wi->ctr_fd[i] = counter_open(i, wi->ctr_group);
+		if (wi->ctr_fd[i] < 0)
+			continue;
+		if (wi->ctr_group < 0)
+			wi->ctr_group = wi->ctr_fd[i];
+		wi->ctr_mask |= 1 << i;
+	}
+}
+
+void counters_start(struct work_instance *wi)
+{
+	if (wi->ctr_group < 0)
+		return;
+
+	ioctl(wi->ctr_group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(wi->ctr_group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/* stop the group, keep the counts in wi->ctr[], and close it */
+void counters_stop(struct work_instance *wi)
+{
+	struct {
+		unsigned long long nr;
+		unsigned long long time_enabled;
+		unsigned long long time_running;
+		unsigned long long values[NUM_COUNTERS];
+	} rf;
+	int i, n = 0;
+
+	if (wi->ctr_group < 0)
+		return;
+
+	ioctl(wi->ctr_group, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	if (read(wi->ctr_group, &rf, sizeof(rf)) < 0)
+		wi->ctr_mask = 0;
+
+	/* the group reads back in the order counters_open() added them */
+	for (i = 0; i < NUM_COUNTERS; i++) {
+		if (!(wi->ctr_mask & (1 << i)))
+			continue;
+		wi->ctr[i] = rf.values[n++];
+		if (rf.time_running && rf.time_running < rf.time_enabled)
+			wi->ctr[i] = (double)wi->ctr[i] * rf.time_enabled / rf.time_running;
+	}
+
+	for (i = NUM_COUNTERS - 1; i >= 0; i--)
+		if (wi->ctr_fd[i] >= 0)
+			close(wi->ctr_fd[i]);
+	wi->ctr_group = -1;
+}
+
+int counted(struct work_instance *wi, int ctr)
+{
+	return !!(wi->ctr_mask & (1 << ctr));
+}
+
+static double elapsed_sec(struct work_instance *wi)
+{
+	return (double)(wi->cycles + wi->cache_cycles) / tsc_per_sec;
+}
+
+/* instructions per core cycle, 0 if not counted */
+double counters_ipc(struct work_instance *wi)
+{
+	if (!counted(wi, CTR_CYCLES) || !counted(wi, CTR_INSTRUCTIONS) || !wi->ctr[CTR_CYCLES])
+		return 0;
+
+	return (double)wi->ctr[CTR_INSTRUCTIONS] / wi->ctr[CTR_CYCLES];
+}
+
+/* ctr per second of run(), 0 if not counted */
+double counter_per_sec(struct work_instance *wi, int ctr)
+{
+	if (!counted(wi, ctr) || !elapsed_sec(wi))
+		return 0;
+
+	return wi->ctr[ctr] / elapsed_sec(wi);
+}
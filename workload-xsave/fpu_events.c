@@ -0,0 +1,591 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * fpu_events.c - count the kernel's x86_fpu tracepoints per worker
+ *
+ * With -X, yogini attaches to every x86_fpu:* tracepoint itself with
+ * perf_event_open(2), rather than leaving trace-cmd to record and format
+ * them. The kernel saves a task's registers inside the context switch,
+ * after perf has switched out that task's own events, so events are
+ * opened per CPU, not per thread. Each CPU has one mmap'd ring that all
+ * its x86_fpu events write to. The main thread drains the rings while
+ * the workers run, keeps the samples of each worker's thread between
+ * the start and end of its run(), and counts them per event and per
+ * xfeatures mask. Samples lost to a full ring are counted too.
+ *
+ * The kernel saves a task's registers on a context switch and then traces
+ * x86_fpu_regs_deactivated, and traces x86_fpu_after_save when it saves
+ * them for another reason, so XSAVE is the sum of the two. XRSTOR is
+ * x86_fpu_after_restore where the kernel has it, else
+ * x86_fpu_regs_activated, which follows each restore of user registers
+ * on return to user space in newer kernels.
+ *
+ * With -X FILE, the kept samples are also written to FILE, little endian:
+ * struct fpu_dump_header, one struct fpu_dump_event per x86_fpu event,
+ * then struct fpu_dump_sample until the end of the file.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <err.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "yogini.h"
+
+#define FPU_EVENTS_DIR	"events/x86_fpu/"
+#define FPU_MAX_EVENTS	16
+#define FPU_MAX_CPUS	1024
+/* per CPU ring, in pages, a power of 2, less if it can not be locked */
+#define FPU_RING_PAGES	512
+#define PERF_PARANOID	"/proc/sys/kernel/perf_event_paranoid"
+#define PERF_MLOCK_KB	"/proc/sys/kernel/perf_event_mlock_kb"
+#define FPU_DUMP_MAGIC	"YOGFPUEV"
+
+enum { FPU_OTHER, FPU_XSAVE, FPU_XRSTOR };
+
+struct fpu_event {
+	char name[FPU_EVENT_NAME];
+	int id;			/* tracepoint ID, common_type of its samples */
+	int xfeatures;		/* offset of xfeatures in its raw data, -1 if none */
+	int kind;		/* FPU_* */
+};
+
+struct fpu_ring {
+	int fd;			/* the first event opened on this CPU, -1 if none */
+	struct perf_event_mmap_page *page;
+};
+
+struct fpu_dump_header {
+	char magic[8];
+	uint32_t num_events;
+	uint32_t reserved;
+};
+
+struct fpu_dump_event {
+	uint32_t id;
+	char name[FPU_EVENT_NAME];
+};
+
+struct fpu_dump_sample {
+	uint32_t thread;
+	uint32_t cpu;
+	uint64_t time_ns;	/* CLOCK_MONOTONIC */
+	uint32_t id;
+	uint32_t reserved;
+	uint64_t xfeatures;
+};
+
+/* the layout of PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU | PERF_SAMPLE_RAW */
+struct fpu_sample {
+	struct perf_event_header header;
+	uint32_t pid, tid;
+	uint64_t time;
+	uint32_t cpu, res;
+	uint32_t size;
+	unsigned char data[];
+};
+
+char *fpu_events_file;
+int fpu_events;
+unsigned long long fpu_events_lost;
+
+static struct fpu_event fpu_event_list[FPU_MAX_EVENTS];
+static int num_fpu_events;
+static int fpu_event_fds[FPU_MAX_CPUS][FPU_MAX_EVENTS];
+static struct fpu_ring fpu_rings[FPU_MAX_CPUS];
+static int num_fpu_cpus;
+static FILE *fpu_dump;
+static size_t page_size;
+static unsigned int fpu_ring_pages;
+
+/* -X count counts only, -X FILE also dumps the samples to FILE */
+int parse_fpu_events_cmd(char *input_string)
+{
+	if (!*input_string)
+		return -1;
+	fpu_events = 1;
+	if (strcmp(input_string, "count"))
+		fpu_events_file = input_string;
+	return 0;
+}
+
+static char *tracefs_dir(void)
+{
+	static char *dirs[] = { "/sys/kernel/tracing/", "/sys/kernel/debug/tracing/" };
+	char path[PATH_MAX];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+		snprintf(path, sizeof(path), "%s%s", dirs[i], FPU_EVENTS_DIR);
+		if (access(path, R_OK) == 0)
+			return dirs[i];
+	}
+	return NULL;
+}
+
+/* ID and the offset of xfeatures, from the event's format file */
+static int read_format(char *tracefs, struct fpu_event *ev)
+{
+	char path[PATH_MAX], line[256];
+	int offset;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s%s%s/format", tracefs, FPU_EVENTS_DIR, ev->name);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+
+	ev->id = -1;
+	ev->xfeatures = -1;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "ID: %d", &ev->id) == 1)
+			continue;
+		if (strstr(line, " xfeatures;") && sscanf(strstr(line, "offset:"), "offset:%d", &offset) == 1)
+			ev->xfeatures = offset;
+	}
+	fclose(fp);
+
+	return ev->id < 0 ? -1 : 0;
+}
+
+static long read_proc_long(char *path, long def)
+{
+	FILE *fp;
+	long val;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return def;
+	if (fscanf(fp, "%ld", &val) != 1)
+		val = def;
+	fclose(fp);
+	return val;
+}
+
+/*
+ * fpu_ring_size()
+ * FPU_RING_PAGES per CPU, unless that is more than the rings may lock:
+ * without root or perf_event_paranoid -1, the kernel lets a user lock
+ * perf_event_mlock_kb per online CPU plus RLIMIT_MEMLOCK, in all, and
+ * each ring takes its data pages plus a header page
+ */
+static unsigned int fpu_ring_size(void)
+{
+	unsigned long long budget;
+	unsigned int pages;
+	struct rlimit rl;
+	long kb;
+
+	if (geteuid() == 0 || read_proc_long(PERF_PARANOID, 2) < 0)
+		return FPU_RING_PAGES;
+
+	kb = read_proc_long(PERF_MLOCK_KB, 516);
+	budget = kb * 1024 / page_size * sysconf(_SC_NPROCESSORS_ONLN);
+	if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0) {
+		if (rl.rlim_cur == RLIM_INFINITY)
+			return FPU_RING_PAGES;
+		budget += rl.rlim_cur / page_size;
+	}
+	budget /= num_fpu_cpus;
+
+	for (pages = FPU_RING_PAGES; pages > 1 && pages + 1 > budget; pages /= 2)
+		;
+	if (pages + 1 > budget)
+		errx(1, "-X: perf_event_mlock_kb %ld is too small for a ring on each of %d CPUs, run as root",
+		     kb, num_fpu_cpus);
+	return pages;
+}
+
+static int compare_event(const void *a, const void *b)
+{
+	return strcmp(((const struct fpu_event *)a)->name, ((const struct fpu_event *)b)->name);
+}
+
+/* every x86_fpu:* tracepoint, by name */
+static void find_fpu_events(void)
+{
+	struct dirent *de;
+	char path[PATH_MAX];
+	char *tracefs;
+	int restore = 0;
+	DIR *dir;
+	int i;
+
+	tracefs = tracefs_dir();
+	if (!tracefs)
+		errx(1, "-X: no x86_fpu events, is tracefs mounted on /sys/kernel/tracing?");
+
+	snprintf(path, sizeof(path), "%s%s", tracefs, FPU_EVENTS_DIR);
+	dir = opendir(path);
+	if (!dir)
+		err(1, "%s", path);
+
+	while ((de = readdir(dir)) && num_fpu_events < FPU_MAX_EVENTS) {
+		struct fpu_event *ev = &fpu_event_list[num_fpu_events];
+
+		if (strncmp(de->d_name, "x86_fpu_", 8) || strlen(de->d_name) >= FPU_EVENT_NAME)
+			continue;
+		strcpy(ev->name, de->d_name);
+		if (read_format(tracefs, ev))
+			continue;
+		num_fpu_events++;
+	}
+	closedir(dir);
+
+	if (!num_fpu_events)
+		errx(1, "-X: can not read the x86_fpu events in %s", path);
+	qsort(fpu_event_list, num_fpu_events, sizeof(struct fpu_event), compare_event);
+
+	for (i = 0; i < num_fpu_events; i++)
+		if (strcmp(fpu_event_list[i].name, "x86_fpu_after_restore") == 0)
+			restore = 1;
+	for (i = 0; i < num_fpu_events; i++) {
+		struct fpu_event *ev = &fpu_event_list[i];
+
+		if (strcmp(ev->name, "x86_fpu_after_save") == 0 ||
+		    strcmp(ev->name, "x86_fpu_regs_deactivated") == 0)
+			ev->kind = FPU_XSAVE;
+		else if (strcmp(ev->name, restore ? "x86_fpu_after_restore" :
+				"x86_fpu_regs_activated") == 0)
+			ev->kind = FPU_XRSTOR;
+		else
+			ev->kind = FPU_OTHER;
+	}
+}
+
+static int perf_open_tracepoint(int id, int cpu, int group)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_TRACEPOINT;
+	attr.config = id;
+	attr.sample_period = 1;
+	attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU | PERF_SAMPLE_RAW;
+	/* the same clock the workers stamp run() with */
+	attr.use_clockid = 1;
+	attr.clockid = CLOCK_MONOTONIC;
+	/* wake the main thread when a ring is a quarter full */
+	attr.watermark = 1;
+	attr.wakeup_watermark = fpu_ring_pages * page_size / 4;
+	attr.disabled = 1;
+
+	/* every task, on this CPU */
+	return syscall(SYS_perf_event_open, &attr, -1, cpu, group, 0);
+}
+
+static void write_dump_header(void)
+{
+	struct fpu_dump_header dh = { FPU_DUMP_MAGIC };
+	int i;
+
+	fpu_dump = fopen(fpu_events_file, "w");
+	if (!fpu_dump)
+		err(1, "%s", fpu_events_file);
+
+	dh.num_events = num_fpu_events;
+	if (fwrite(&dh, sizeof(dh), 1, fpu_dump) != 1)
+		err(1, "%s", fpu_events_file);
+	for (i = 0; i < num_fpu_events; i++) {
+		struct fpu_dump_event de;
+
+		memset(&de, 0, sizeof(de));
+		de.id = fpu_event_list[i].id;
+		strcpy(de.name, fpu_event_list[i].name);
+		if (fwrite(&de, sizeof(de), 1, fpu_dump) != 1)
+			err(1, "%s", fpu_events_file);
+	}
+}
+
+/*
+ * fpu_events_open()
+ * open and enable every x86_fpu event on every CPU, before the workers start
+ */
+void fpu_events_open(struct work_instance *first)
+{
+	struct work_instance *wi;
+	int cpu, i;
+
+	if (!fpu_events)
+		return;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (!num_fpu_events)
+		find_fpu_events();
+	if (fpu_events_file && !fpu_dump)
+		write_dump_header();
+
+	num_fpu_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (num_fpu_cpus > FPU_MAX_CPUS)
+		num_fpu_cpus = FPU_MAX_CPUS;
+	fpu_ring_pages = fpu_ring_size();
+
+	for (cpu = 0; cpu < num_fpu_cpus; cpu++) {
+		struct fpu_ring *ring = &fpu_rings[cpu];
+
+		ring->fd = -1;
+		for (i = 0; i < num_fpu_events; i++) {
+			int fd = perf_open_tracepoint(fpu_event_list[i].id, cpu, -1);
+
+			fpu_event_fds[cpu][i] = fd;
+			if (fd < 0)
+				continue;
+			if (ring->fd >= 0) {
+				/* the rest write to the ring of the first */
+				if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, ring->fd))
+					err(1, "-X: PERF_EVENT_IOC_SET_OUTPUT");
+				continue;
+			}
+
+			/* the first event on a CPU owns its ring */
+			ring->fd = fd;
+			ring->page = mmap(NULL, (fpu_ring_pages + 1) * page_size,
+					  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (ring->page == MAP_FAILED)
+				err(1, "-X: mmap");
+		}
+	}
+
+	for (cpu = 0; cpu < num_fpu_cpus; cpu++)
+		if (fpu_rings[cpu].fd >= 0)
+			break;
+	if (cpu == num_fpu_cpus)
+		errx(1, "-X: can not open x86_fpu on any CPU, is perf_event_paranoid -1 or are you root?");
+
+	fpu_events_lost = 0;
+	for (wi = first; wi; wi = wi->next) {
+		free(wi->fpu_counts);
+		wi->fpu_counts = NULL;
+		wi->num_fpu_counts = 0;
+		wi->xsaves = 0;
+		wi->xrstors = 0;
+		wi->tid = 0;
+		wi->run_bgn_ns = 0;
+		wi->run_end_ns = 0;
+	}
+
+	for (cpu = 0; cpu < num_fpu_cpus; cpu++)
+		for (i = 0; i < num_fpu_events; i++)
+			if (fpu_event_fds[cpu][i] >= 0)
+				ioctl(fpu_event_fds[cpu][i], PERF_EVENT_IOC_ENABLE, 0);
+}
+
+static struct fpu_event *find_event(int id)
+{
+	int i;
+
+	for (i = 0; i < num_fpu_events; i++)
+		if (fpu_event_list[i].id == id)
+			return &fpu_event_list[i];
+	return NULL;
+}
+
+static void fpu_count(struct work_instance *wi, struct fpu_event *ev, unsigned long long xfeatures)
+{
+	struct fpu_count *fc;
+	int i;
+
+	if (ev->kind == FPU_XSAVE)
+		wi->xsaves++;
+	else if (ev->kind == FPU_XRSTOR)
+		wi->xrstors++;
+
+	for (i = 0; i < wi->num_fpu_counts; i++) {
+		fc = &wi->fpu_counts[i];
+		if (fc->event == ev - fpu_event_list && fc->xfeatures == xfeatures) {
+			fc->count++;
+			return;
+		}
+	}
+
+	wi->fpu_counts = realloc(wi->fpu_counts, sizeof(struct fpu_count) * (wi->num_fpu_counts + 1));
+	if (!wi->fpu_counts)
+		err(1, "fpu_counts");
+	fc = &wi->fpu_counts[wi->num_fpu_counts++];
+	fc->event = ev - fpu_event_list;
+	fc->xfeatures = xfeatures;
+	fc->count = 1;
+}
+
+/* count the sample if it is a worker's, during its run() */
+static void fpu_sample(struct work_instance *first, struct fpu_sample *s)
+{
+	unsigned long long xfeatures = 0, bgn, end;
+	struct work_instance *wi;
+	struct fpu_event *ev;
+	uint16_t id;
+
+	if (s->size < sizeof(id))
+		return;
+	memcpy(&id, s->data, sizeof(id));
+	ev = find_event(id);
+	if (!ev)
+		return;
+	if (ev->xfeatures >= 0 && ev->xfeatures + sizeof(xfeatures) <= s->size)
+		memcpy(&xfeatures, s->data + ev->xfeatures, sizeof(xfeatures));
+
+	for (wi = first; wi; wi = wi->next)
+		if (wi->tid == s->tid)
+			break;
+	if (!wi)
+		return;
+	/* run_end_ns is 0 while run() is still going */
+	bgn = __atomic_load_n(&wi->run_bgn_ns, __ATOMIC_ACQUIRE);
+	end = __atomic_load_n(&wi->run_end_ns, __ATOMIC_ACQUIRE);
+	if (!bgn || s->time < bgn || (end && s->time > end))
+		return;
+
+	fpu_count(wi, ev, xfeatures);
+
+	if (fpu_dump) {
+		struct fpu_dump_sample ds = { 0 };
+
+		ds.thread = wi->thread_number;
+		ds.cpu = s->cpu;
+		ds.time_ns = s->time;
+		ds.id = id;
+		ds.xfeatures = xfeatures;
+		if (fwrite(&ds, sizeof(ds), 1, fpu_dump) != 1)
+			err(1, "%s", fpu_events_file);
+	}
+}
+
+/*
+ * drain_ring()
+ * consume every record in ring, copying out the ones that wrap
+ */
+static void drain_ring(struct work_instance *first, struct fpu_ring *ring)
+{
+	unsigned char *data = (unsigned char *)ring->page + page_size;
+	unsigned long long size = fpu_ring_pages * page_size;
+	unsigned long long head, tail;
+	unsigned char buf[1024];
+
+	head = __atomic_load_n(&ring->page->data_head, __ATOMIC_ACQUIRE);
+	tail = ring->page->data_tail;
+
+	while (tail < head) {
+		struct perf_event_header *h = (struct perf_event_header *)(data + tail % size);
+
+		if (tail % size + h->size > size) {
+			unsigned long long part = size - tail % size;
+
+			if (h->size > sizeof(buf))
+				break;
+			memcpy(buf, data + tail % size, part);
+			memcpy(buf + part, data, h->size - part);
+			h = (struct perf_event_header *)buf;
+		}
+
+		if (h->type == PERF_RECORD_SAMPLE)
+			fpu_sample(first, (struct fpu_sample *)h);
+		else if (h->type == PERF_RECORD_LOST)
+			fpu_events_lost += ((struct { struct perf_event_header h; uint64_t id, lost; } *)h)->lost;
+		tail += h->size;
+	}
+
+	__atomic_store_n(&ring->page->data_tail, head, __ATOMIC_RELEASE);
+}
+
+static long long ms_left(struct timespec *deadline)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (deadline->tv_sec - now.tv_sec) * 1000LL + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+}
+
+/*
+ * fpu_events_poll()
+ * for timeout_ms, drain every ring each time one is a quarter full,
+ * then drain them once more
+ */
+void fpu_events_poll(struct work_instance *first, int timeout_ms)
+{
+	struct pollfd pfd[FPU_MAX_CPUS];
+	struct timespec deadline;
+	int cpu, n = 0;
+	long long left;
+
+	if (!fpu_events)
+		return;
+
+	for (cpu = 0; cpu < num_fpu_cpus; cpu++) {
+		if (fpu_rings[cpu].fd < 0)
+			continue;
+		pfd[n].fd = fpu_rings[cpu].fd;
+		pfd[n++].events = POLLIN;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += timeout_ms % 1000 * 1000000L;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_nsec -= 1000000000;
+		deadline.tv_sec++;
+	}
+
+	do {
+		left = ms_left(&deadline);
+		if (left > 0)
+			poll(pfd, n, left);
+		for (cpu = 0; cpu < num_fpu_cpus; cpu++)
+			if (fpu_rings[cpu].fd >= 0)
+				drain_ring(first, &fpu_rings[cpu]);
+	} while (left > 0);
+}
+
+/* disable, drain and close every event, after the workers are done */
+void fpu_events_close(struct work_instance *first)
+{
+	int cpu, i;
+
+	if (!fpu_events)
+		return;
+
+	for (cpu = 0; cpu < num_fpu_cpus; cpu++)
+		for (i = 0; i < num_fpu_events; i++)
+			if (fpu_event_fds[cpu][i] >= 0)
+				ioctl(fpu_event_fds[cpu][i], PERF_EVENT_IOC_DISABLE, 0);
+
+	fpu_events_poll(first, 0);
+
+	for (cpu = 0; cpu < num_fpu_cpus; cpu++) {
+		if (fpu_rings[cpu].fd >= 0)
+			munmap(fpu_rings[cpu].page, (fpu_ring_pages + 1) * page_size);
+		for (i = 0; i < num_fpu_events; i++)
+			if (fpu_event_fds[cpu][i] >= 0)
+				close(fpu_event_fds[cpu][i]);
+	}
+
+	if (fpu_dump && fflush(fpu_dump))
+		err(1, "%s", fpu_events_file);
+}
+
+/* the dump spans every run under --sweep */
+void fpu_events_finish(void)
+{
+	if (fpu_dump && fclose(fpu_dump))
+		err(1, "%s", fpu_events_file);
+	fpu_dump = NULL;
+}
+
+char *fpu_event_name(int event)
+{
+	/* drop the common prefix */
+	return fpu_event_list[event].name + strlen("x86_fpu_");
+}
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * histogram.c - log-linear latency histograms for yogini
+ *
+ * Values below 2^HIST_PRECISION_BITS are counted exactly, larger values
+ * land in one of 2^(HIST_PRECISION_BITS - 1) linear buckets per power of two,
+ * so every recorded value is within ~3% of its bucket.
+ *
+ * A histogram is written only by the thread that owns it,
+ * and read by main() after that thread has been joined.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#include <stdlib.h>
+#include <err.h>
+#include "yogini.h"
+
+#define HALF_SUB	(1ULL << (HIST_PRECISION_BITS - 1))
+
+static unsigned int value_to_index(unsigned long long v)
+{
+	unsigned int e;
+
+	if (v < (1ULL << HIST_PRECISION_BITS))
+		return v;
+
+	e = 63 - __builtin_clzll(v);
+	return (e - HIST_PRECISION_BITS + 1) * HALF_SUB + (v >> (e - HIST_PRECISION_BITS + 1));
+}
+
+/* highest value that maps to bucket idx */
+static unsigned long long index_to_value(unsigned int idx)
+{
+	unsigned int shift;
+	unsigned long long mant;
+
+	if (idx < (1ULL << HIST_PRECISION_BITS))
+		return idx;
+
+	shift = idx / HALF_SUB - 1;
+	mant = idx % HALF_SUB + HALF_SUB;
+
+	return ((mant + 1) << shift) - 1;
+}
+
+struct histogram *hist_alloc(void)
+{
+	struct histogram *h;
+
+	h = calloc(1, sizeof(struct histogram));
+	if (!h)
+		err(1, "histogram");
+
+	return h;
+}
+
+void hist_record(struct histogram *h, unsigned long long v)
+{
+	h->buckets[value_to_index(v)]++;
+	h->count++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+}
+
+void hist_merge(struct histogram *dst, struct histogram *src)
+{
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/*
+ * hist_percentile()
+ * return the value below which pct percent of the samples fall,
+ * 0 for an empty histogram
+ */
+unsigned long long hist_percentile(struct histogram *h, double pct)
+{
+	unsigned long long target, seen = 0;
+	int i;
+
+	if (h->count == 0)
+		return 0;
+
+	target = (unsigned long long)(h->count * pct / 100.0 + 0.5);
+	if (target == 0)
+		target = 1;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= target) {
+			unsigned long long v = index_to_value(i);
+
+			return v < h->max ? v : h->max;
+		}
+	}
+	return h->max;
+}
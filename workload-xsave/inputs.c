@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * inputs.c - private or shared read-only workload inputs
+ *
+ * By default every worker allocates and fills its own inputs.
+ * With "-i shared", the first worker to ask for an input buffer allocates
+ * and fills it, and later workers of the same workload map the same copy.
+ * "-i node" keeps one copy per NUMA node, bound to that node.
+ * Outputs stay private to each worker either way.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "yogini.h"
+
+int input_mode = INPUTS_PRIVATE;
+
+static char *input_mode_names[] = {
+	[INPUTS_PRIVATE] = "private",
+	[INPUTS_SHARED] = "shared",
+	[INPUTS_NODE] = "node",
+};
+
+struct shared_input {
+	struct workload *workload;
+	int buffer;
+	size_t bytes;
+	int node;		/* -1 unless INPUTS_NODE */
+	int policy;
+	void *ptr;
+	int refs;
+	pthread_mutex_t fill_lock;	/* held while ptr is being filled */
+	struct shared_input *next;
+};
+
+static struct shared_input *shared_inputs;
+static pthread_mutex_t shared_inputs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int parse_inputs_cmd(char *input_string)
+{
+	int i;
+
+	for (i = INPUTS_PRIVATE; i <= INPUTS_NODE; i++) {
+		if (strcmp(input_string, input_mode_names[i]) == 0) {
+			input_mode = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+char *input_mode_name(int mode)
+{
+	if (mode < 0)
+		return "none";
+	return input_mode_names[mode];
+}
+
+static int current_node(void)
+{
+	unsigned int cpu, node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL))
+		err(1, "getcpu");
+	return node;
+}
+
+/*
+ * find_shared_input()
+ * return the entry for this buffer of wi's workload on node,
+ * creating it if needed, with a reference taken
+ */
+static struct shared_input *find_shared_input(struct work_instance *wi, int buffer,
+					      size_t bytes, int node)
+{
+	struct shared_input *si;
+
+	pthread_mutex_lock(&shared_inputs_lock);
+	for (si = shared_inputs; si; si = si->next)
+		if (si->workload == wi->workload && si->buffer == buffer &&
+		    si->bytes == bytes && si->node == node)
+			break;
+
+	if (!si) {
+		si = calloc(1, sizeof(struct shared_input));
+		if (!si)
+			err(1, "shared input");
+		si->workload = wi->workload;
+		si->buffer = buffer;
+		si->bytes = bytes;
+		si->node = node;
+		pthread_mutex_init(&si->fill_lock, NULL);
+		si->next = shared_inputs;
+		shared_inputs = si;
+	}
+	si->refs++;
+	pthread_mutex_unlock(&shared_inputs_lock);
+
+	return si;
+}
+
+/*
+ * get_input_buffer()
+ * return bytes of read-only input number buffer for wi, filled by fill()
+ * each get_input_buffer() is paired with a put_input_buffer()
+ *
+ * The fill key is the buffer number alone, in every mode, so private,
+ * shared and node inputs hold the same values and differ only in placement.
+ */
+void *get_input_buffer(struct work_instance *wi, int buffer, size_t bytes, input_fill_fn fill)
+{
+	struct shared_input *si;
+	void *ptr;
+
+	wi->inputs = input_mode;
+
+	if (input_mode == INPUTS_PRIVATE) {
+		/* cache-line aligned, as the mmap()ed shared copies are */
+		if (posix_memalign(&ptr, 64, bytes))
+			errx(1, "%s: input %d", wi->workload->name, buffer);
+		fill(ptr, bytes, buffer);
+		return ptr;
+	}
+
+	si = find_shared_input(wi, buffer, bytes,
+			       input_mode == INPUTS_NODE ? current_node() : -1);
+
+	/* the first worker in fills it, the rest wait here until it is ready */
+	pthread_mutex_lock(&si->fill_lock);
+	if (!si->ptr) {
+		si->policy = wi->workload->alloc_policy;
+		if (input_mode == INPUTS_NODE)
+			si->policy = (si->policy & ~ALLOC_NUMA_INTERLEAVE) | ALLOC_NUMA_LOCAL;
+		ptr = alloc_policy_buffer(wi->workload->name, bytes, si->policy);
+		fill(ptr, bytes, buffer);
+		si->ptr = ptr;
+	}
+	pthread_mutex_unlock(&si->fill_lock);
+
+	return si->ptr;
+}
+
+void put_input_buffer(struct work_instance *wi, void *ptr)
+{
+	struct shared_input *si, **prev;
+
+	if (!ptr)
+		return;
+
+	pthread_mutex_lock(&shared_inputs_lock);
+	for (prev = &shared_inputs; (si = *prev); prev = &si->next)
+		if (si->ptr == ptr)
+			break;
+
+	if (!si) {
+		pthread_mutex_unlock(&shared_inputs_lock);
+		free(ptr);
+		return;
+	}
+
+	if (--si->refs == 0) {
+		*prev = si->next;
+		free_policy_buffer(si->ptr, si->bytes, si->policy);
+		pthread_mutex_destroy(&si->fill_lock);
+		free(si);
+	}
+	pthread_mutex_unlock(&shared_inputs_lock);
+}
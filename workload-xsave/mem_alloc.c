@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * mem_alloc.c - page size and NUMA policies for workload buffers
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "yogini.h"
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB	(21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB	(30 << MAP_HUGE_SHIFT)
+#endif
+
+#define SIZE_2MB	(2UL * 1024 * 1024)
+#define SIZE_4KB	4096UL
+
+static char *alloc_page_names[] = {
+	[ALLOC_PAGE_DEFAULT] = "default",
+	[ALLOC_PAGE_4K] = "4k",
+	[ALLOC_PAGE_THP] = "thp",
+	[ALLOC_PAGE_2M] = "2m",
+	[ALLOC_PAGE_1G] = "1g",
+};
+
+static int parse_alloc_token(char *token, int *policy)
+{
+	int i;
+
+	for (i = ALLOC_PAGE_DEFAULT; i <= ALLOC_PAGE_1G; i++) {
+		if (strcmp(token, alloc_page_names[i]) == 0) {
+			*policy = (*policy & ~ALLOC_PAGE_MASK) | i;
+			return 0;
+		}
+	}
+
+	if (strcmp(token, "local") == 0)
+		*policy = (*policy & ~ALLOC_NUMA_INTERLEAVE) | ALLOC_NUMA_LOCAL;
+	else if (strcmp(token, "interleave") == 0)
+		*policy = (*policy & ~ALLOC_NUMA_LOCAL) | ALLOC_NUMA_INTERLEAVE;
+	else if (strcmp(token, "populate") == 0)
+		*policy |= ALLOC_POPULATE;
+	else
+		return -1;
+	return 0;
+}
+
+/*
+ * parse_alloc_cmd()
+ * "[workload=]page[,local|interleave][,populate]"
+ * without a workload name, the policy applies to every workload
+ */
+int parse_alloc_cmd(char *input_string)
+{
+	char *str, *policy_str, *token, *saveptr;
+	struct workload *wp = NULL;
+	int policy = 0;
+
+	str = strdup(input_string);
+	if (!str)
+		err(1, "alloc");
+
+	policy_str = strchr(str, '=');
+	if (policy_str) {
+		*policy_str++ = '\0';
+		wp = find_workload(str);
+		if (!wp)
+			goto bad;
+	} else {
+		policy_str = str;
+	}
+
+	for (token = strtok_r(policy_str, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		if (parse_alloc_token(token, &policy))
+			goto bad;
+	}
+
+	if (wp) {
+		wp->alloc_policy = policy;
+	} else {
+		for (wp = all_workloads; wp; wp = wp->next)
+			wp->alloc_policy = policy;
+	}
+
+	free(str);
+	return 0;
+bad:
+	free(str);
+	return -1;
+}
+
+char *alloc_policy_name(int policy, char *buf, int len)
+{
+	if (policy < 0) {
+		snprintf(buf, len, "none");
+		return buf;
+	}
+
+	snprintf(buf, len, "%s%s%s", alloc_page_names[policy & ALLOC_PAGE_MASK],
+		 policy & ALLOC_NUMA_LOCAL ? ",local" :
+		 policy & ALLOC_NUMA_INTERLEAVE ? ",interleave" : "",
+		 policy & ALLOC_POPULATE ? ",populate" : "");
+	return buf;
+}
+
+static size_t alloc_size(size_t bytes, int policy)
+{
+	size_t unit = SIZE_4KB;
+
+	switch (policy & ALLOC_PAGE_MASK) {
+	case ALLOC_PAGE_2M:
+		unit = SIZE_2MB;
+		break;
+	case ALLOC_PAGE_1G:
+		unit = SIZE_1GB;
+		break;
+	}
+
+	return (bytes + unit - 1) / unit * unit;
+}
+
+static void set_numa_policy(void *ptr, size_t bytes, int policy)
+{
+	unsigned long nodemask[16] = { 0 };
+	unsigned int cpu, node;
+	int mode;
+
+	if (policy & ALLOC_NUMA_LOCAL) {
+		if (syscall(SYS_getcpu, &cpu, &node, NULL))
+			err(1, "getcpu");
+		nodemask[node / 64] |= 1UL << (node % 64);
+		mode = MPOL_BIND;
+	} else if (policy & ALLOC_NUMA_INTERLEAVE) {
+		FILE *fp;
+		char line[256];
+		int *nodes;
+		int num, i;
+
+		fp = fopen("/sys/devices/system/node/online", "r");
+		if (!fp || !fgets(line, sizeof(line), fp))
+			errx(1, "interleave: can not read online NUMA nodes");
+		fclose(fp);
+
+		num = parse_cpulist(line, &nodes);
+		if (num < 0)
+			errx(1, "interleave: bad node list %s", line);
+		for (i = 0; i < num; i++)
+			if (nodes[i] < 16 * 64)
+				nodemask[nodes[i] / 64] |= 1UL << (nodes[i] % 64);
+		free(nodes);
+		mode = MPOL_INTERLEAVE;
+	} else {
+		return;
+	}
+
+	if (syscall(SYS_mbind, ptr, bytes, mode, nodemask, 16 * 64, 0))
+		err(1, "mbind");
+}
+
+/*
+ * alloc_policy_buffer()
+ * allocate bytes according to policy, name is for error messages
+ */
+void *alloc_policy_buffer(char *name, size_t bytes, int policy)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	size_t size = alloc_size(bytes, policy);
+	char *ptr;
+	size_t i;
+
+	switch (policy & ALLOC_PAGE_MASK) {
+	case ALLOC_PAGE_2M:
+		flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+		break;
+	case ALLOC_PAGE_1G:
+		flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+		break;
+	}
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (ptr == MAP_FAILED) {
+		if (flags & MAP_HUGETLB)
+			err(1, "%s: mmap %zu bytes of hugetlb pages, check /proc/sys/vm/nr_hugepages",
+			    name, size);
+		err(1, "%s: mmap %zu bytes", name, size);
+	}
+
+	switch (policy & ALLOC_PAGE_MASK) {
+	case ALLOC_PAGE_4K:
+		if (madvise(ptr, size, MADV_NOHUGEPAGE))
+			err(1, "madvise MADV_NOHUGEPAGE");
+		break;
+	case ALLOC_PAGE_THP:
+		if (madvise(ptr, size, MADV_HUGEPAGE))
+			err(1, "madvise MADV_HUGEPAGE");
+		break;
+	}
+
+	set_numa_policy(ptr, size, policy);
+
+	/* fault every page in now, rather than inside the timed loop */
+	if (policy & ALLOC_POPULATE)
+		for (i = 0; i < size; i += SIZE_4KB)
+			ptr[i] = 0;
+
+	return ptr;
+}
+
+void free_policy_buffer(void *ptr, size_t bytes, int policy)
+{
+	if (ptr)
+		munmap(ptr, alloc_size(bytes, policy));
+}
+
+/*
+ * alloc_work_buffer()
+ * allocate bytes for wi according to its workload's alloc_policy,
+ * and record the policy in wi for the report
+ */
+void *alloc_work_buffer(struct work_instance *wi, size_t bytes)
+{
+	wi->alloc_policy = wi->workload->alloc_policy;
+	return alloc_policy_buffer(wi->workload->name, bytes, wi->alloc_policy);
+}
+
+void free_work_buffer(struct work_instance *wi, void *ptr, size_t bytes)
+{
+	free_policy_buffer(ptr, bytes, wi->workload->alloc_policy);
+}
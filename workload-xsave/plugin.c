@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * plugin.c - load out-of-tree workloads from libyogini_*.so
+ *
+ * At startup, after the built-in workloads register, yogini dlopen()s
+ * every libyogini_*.so in $YOGINI_PLUGIN_DIR, or YOGINI_PLUGIN_DIR when
+ * it is not set, in name order. A plugin is built like a work_*.c file,
+ * against yogini.h and run_common.c, with -fPIC -shared, and ends with
+ * YOGINI_PLUGIN(register_X). Its workload is registered alongside the
+ * built-ins, so -w and every report mode treat it the same. It calls
+ * back into yogini, e.g. thread_break(), which is linked -rdynamic.
+ *
+ * The ABI is struct workload, struct work_instance and the rest of
+ * yogini.h. A plugin whose YOGINI_PLUGIN_ABI or structure sizes differ
+ * from yogini's is skipped with a warning, as is one whose workload name
+ * is taken.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <err.h>
+#include "yogini.h"
+
+#define PLUGIN_PREFIX	"libyogini_"
+#define PLUGIN_SUFFIX	".so"
+
+_Static_assert(sizeof(struct workload) == YOGINI_WORKLOAD_SIZE,
+	       "struct workload changed: bump YOGINI_PLUGIN_ABI and YOGINI_WORKLOAD_SIZE");
+_Static_assert(sizeof(struct work_instance) == YOGINI_WORK_INSTANCE_SIZE,
+	       "struct work_instance changed: bump YOGINI_PLUGIN_ABI and YOGINI_WORK_INSTANCE_SIZE");
+
+static int plugin_filter(const struct dirent *d)
+{
+	size_t len = strlen(d->d_name);
+
+	return strncmp(d->d_name, PLUGIN_PREFIX, strlen(PLUGIN_PREFIX)) == 0 &&
+	       len > strlen(PLUGIN_PREFIX) + strlen(PLUGIN_SUFFIX) &&
+	       strcmp(d->d_name + len - strlen(PLUGIN_SUFFIX), PLUGIN_SUFFIX) == 0;
+}
+
+/* dlopen path and register its workload, return 0 on success */
+static int load_plugin(const char *path)
+{
+	struct workload *(*reg)(void);
+	unsigned int *abi;
+	size_t *sizes;
+	struct workload *wp;
+	void *handle;
+
+	handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!handle) {
+		warnx("%s", dlerror());
+		return -1;
+	}
+
+	abi = dlsym(handle, "yogini_plugin_abi");
+	sizes = dlsym(handle, "yogini_plugin_sizes");
+	reg = (struct workload *(*)(void))dlsym(handle, "yogini_plugin_register");
+	if (!abi || !sizes || !reg) {
+		warnx("%s: not a yogini plugin", path);
+		goto close;
+	}
+	if (*abi != YOGINI_PLUGIN_ABI) {
+		warnx("%s: plugin ABI %u, yogini ABI %u", path, *abi, YOGINI_PLUGIN_ABI);
+		goto close;
+	}
+	/* the same ABI, but built from a yogini.h edited without a bump */
+	if (sizes[0] != sizeof(struct workload) || sizes[1] != sizeof(struct work_instance)) {
+		warnx("%s: plugin structures are %zu and %zu bytes, yogini's %zu and %zu",
+		      path, sizes[0], sizes[1], sizeof(struct workload),
+		      sizeof(struct work_instance));
+		goto close;
+	}
+
+	/* like the built-ins, NULL if this CPU can not run it */
+	wp = reg();
+	if (!wp)
+		goto close;
+	if (find_workload(wp->name)) {
+		warnx("%s: workload %s already registered", path, wp->name);
+		goto close;
+	}
+
+	/* the handle stays open, run() lives in it */
+	register_workload(wp);
+	return 0;
+close:
+	dlclose(handle);
+	return -1;
+}
+
+/*
+ * load_plugins()
+ * register the workload of every plugin in the plugin directory,
+ * which need not exist unless $YOGINI_PLUGIN_DIR names it
+ */
+void load_plugins(void)
+{
+	struct dirent **names;
+	char path[PATH_MAX];
+	char *dir;
+	int i, n;
+
+	dir = getenv("YOGINI_PLUGIN_DIR");
+	n = scandir(dir ? dir : YOGINI_PLUGIN_DIR, &names, plugin_filter, alphasort);
+	if (n < 0) {
+		if (dir)
+			warn("%s", dir);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir ? dir : YOGINI_PLUGIN_DIR,
+			 names[i]->d_name);
+		load_plugin(path);
+		free(names[i]);
+	}
+	free(names);
+}
@@ -0,0 +1,1221 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * report.c - emit yogini results as text, JSON or CSV
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <err.h>
+#include "yogini.h"
+
+int output_format = FORMAT_TEXT;
+
+struct stat3 {
+	double min;
+	double median;
+	double max;
+};
+
+int parse_format_cmd(char *input_string)
+{
+	if (strcmp(input_string, "text") == 0)
+		output_format = FORMAT_TEXT;
+	else if (strcmp(input_string, "json") == 0)
+		output_format = FORMAT_JSON;
+	else if (strcmp(input_string, "csv") == 0)
+		output_format = FORMAT_CSV;
+	else
+		return -1;
+	return 0;
+}
+
+static double tsc_to_ns(unsigned long long tsc)
+{
+	return (double)tsc * 1e9 / tsc_per_sec;
+}
+
+static double wi_elapsed_ns(struct work_instance *wi)
+{
+	return tsc_to_ns(wi->cycles);
+}
+
+static double wi_throughput(struct work_instance *wi)
+{
+	if (wi->cycles == 0)
+		return 0;
+	return (double)wi->work_done * tsc_per_sec / wi->cycles;
+}
+
+static double wi_per_cycle(struct work_instance *wi)
+{
+	if (wi->cycles == 0)
+		return 0;
+	return (double)wi->work_done / wi->cycles;
+}
+
+/* percent of the workload's theoretical peak at the TSC rate, 0 if unknown */
+static double wi_pct_peak(struct work_instance *wi)
+{
+	if (!wi->workload->peak_per_cycle)
+		return 0;
+	return wi_per_cycle(wi) / wi->workload->peak_per_cycle * 100;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+
+	return (da > db) - (da < db);
+}
+
+/* sorts v[] in place */
+static struct stat3 get_stat3(double *v, int num)
+{
+	struct stat3 st;
+
+	qsort(v, num, sizeof(double), compare_double);
+
+	st.min = v[0];
+	st.max = v[num - 1];
+	if (num % 2)
+		st.median = v[num / 2];
+	else
+		st.median = (v[num / 2 - 1] + v[num / 2]) / 2;
+
+	return st;
+}
+
+static double wi_cycles(struct work_instance *wi)
+{
+	return wi->cycles;
+}
+
+static double wi_start_skew_ns(struct work_instance *wi)
+{
+	return tsc_to_ns(wi->start_skew);
+}
+
+static double wi_setup_ns(struct work_instance *wi)
+{
+	return tsc_to_ns(wi->setup_cycles);
+}
+
+static double wi_cache_ns(struct work_instance *wi)
+{
+	return tsc_to_ns(wi->cache_cycles);
+}
+
+static double wi_switches_per_sec(struct work_instance *wi)
+{
+	return counter_per_sec(wi, CTR_SWITCHES);
+}
+
+static void json_counters(struct work_instance *wi)
+{
+	char *sep = "";
+	int i;
+
+	printf("\"counters\": {");
+	for (i = 0; i < NUM_COUNTERS; i++) {
+		if (!counted(wi, i))
+			continue;
+		printf("%s\"%s\": %llu", sep, counter_names[i], wi->ctr[i]);
+		sep = ", ";
+	}
+	printf("}");
+}
+
+static void text_fpu_counts(struct work_instance *first)
+{
+	struct work_instance *wi;
+	int i;
+
+	for (wi = first; wi; wi = wi->next) {
+		printf("Thread %d:%s x86_fpu %llu XSAVE %llu XRSTOR\n", wi->thread_number,
+		       wi->workload->name, wi->xsaves, wi->xrstors);
+		for (i = 0; i < wi->num_fpu_counts; i++)
+			printf("Thread %d:%s x86_fpu %s xfeatures 0x%llx: %llu\n",
+			       wi->thread_number, wi->workload->name,
+			       fpu_event_name(wi->fpu_counts[i].event),
+			       wi->fpu_counts[i].xfeatures, wi->fpu_counts[i].count);
+	}
+	if (fpu_events_lost)
+		printf("x86_fpu: %llu samples lost\n", fpu_events_lost);
+}
+
+static void json_fpu_counts(struct work_instance *wi)
+{
+	int i;
+
+	printf("\"x86_fpu\": {\"xsave\": %llu, \"xrstor\": %llu, \"events\": [",
+	       wi->xsaves, wi->xrstors);
+	for (i = 0; i < wi->num_fpu_counts; i++)
+		printf("%s{\"event\": \"%s\", \"xfeatures\": %llu, \"count\": %llu}",
+		       i ? ", " : "", fpu_event_name(wi->fpu_counts[i].event),
+		       wi->fpu_counts[i].xfeatures, wi->fpu_counts[i].count);
+	printf("]}");
+}
+
+static void json_trace_stats(struct trace_stats *ts)
+{
+	printf("\"trace\": {\"iterations\": %llu, \"median_ns\": %.0f, \"threshold_ns\": %.0f, ",
+	       ts->iterations, tsc_to_ns(ts->median), tsc_to_ns(ts->threshold));
+	printf("\"outliers\": %llu, \"max_ns\": %.0f, \"max_iteration\": %llu}",
+	       ts->outliers, tsc_to_ns(ts->max), ts->max_iteration);
+}
+
+struct summary {
+	int num;
+	struct stat3 cycles;
+	struct stat3 ns;
+	struct stat3 tput;
+	struct stat3 skew;
+	struct stat3 setup;
+	struct stat3 mhz;
+	struct stat3 ipc;
+	struct stat3 switches;
+};
+
+/* wp == NULL selects every worker */
+static struct stat3 collect_stat3(struct work_instance *first, struct workload *wp,
+				  double (*get)(struct work_instance *wi), double *v)
+{
+	struct work_instance *wi;
+	int i = 0;
+
+	for (wi = first; wi; wi = wi->next)
+		if (!wp || wi->workload == wp)
+			v[i++] = get(wi);
+
+	return get_stat3(v, i);
+}
+
+/*
+ * summarize()
+ * min/median/max of cycles, elapsed ns, throughput, start skew, setup ns,
+ * core MHz, IPC and context switches/sec
+ * across the workers running workload wp, or all workers if wp is NULL
+ * return the number of such workers, 0 if none
+ */
+static int summarize(struct work_instance *first, struct workload *wp, struct summary *sum)
+{
+	struct work_instance *wi;
+	double *v;
+
+	sum->num = 0;
+	for (wi = first; wi; wi = wi->next)
+		if (!wp || wi->workload == wp)
+			sum->num++;
+	if (sum->num == 0)
+		return 0;
+
+	v = malloc(sizeof(double) * sum->num);
+	if (!v)
+		err(1, "summarize");
+
+	sum->cycles = collect_stat3(first, wp, wi_cycles, v);
+	sum->ns = collect_stat3(first, wp, wi_elapsed_ns, v);
+	sum->tput = collect_stat3(first, wp, wi_throughput, v);
+	sum->skew = collect_stat3(first, wp, wi_start_skew_ns, v);
+	sum->setup = collect_stat3(first, wp, wi_setup_ns, v);
+	sum->mhz = collect_stat3(first, wp, core_clock_mhz, v);
+	sum->ipc = collect_stat3(first, wp, counters_ipc, v);
+	sum->switches = collect_stat3(first, wp, wi_switches_per_sec, v);
+
+	free(v);
+	return sum->num;
+}
+
+/*
+ * merge_break_hist()
+ * merge the thread_break() histograms of the workers running
+ * workload wp with break reason reason into h, those of the
+ * breaks after xstate_release() if released
+ * return the number of breaks merged
+ */
+static unsigned long long merge_break_hist(struct work_instance *first, struct workload *wp,
+					   int reason, int released, struct histogram *h)
+{
+	struct work_instance *wi;
+
+	memset(h, 0, sizeof(*h));
+	for (wi = first; wi; wi = wi->next) {
+		struct histogram *wh = released ? wi->release_hist : wi->break_hist;
+
+		if (wi->workload == wp && wi->break_reason == reason && wh)
+			hist_merge(h, wh);
+	}
+
+	return h->count;
+}
+
+/* XINUSE of wp's workers at their held, or released, breaks */
+static unsigned long long merge_xinuse(struct work_instance *first, struct workload *wp,
+				       int released)
+{
+	unsigned long long xfeatures = 0;
+	struct work_instance *wi;
+
+	for (wi = first; wi; wi = wi->next)
+		if (wi->workload == wp)
+			xfeatures |= released ? wi->release_xinuse : wi->xinuse;
+
+	return xfeatures;
+}
+
+/* released minus held break latency at percentile pct, in ns */
+static double release_delta_ns(struct histogram *held, struct histogram *released, double pct)
+{
+	return tsc_to_ns(hist_percentile(released, pct)) - tsc_to_ns(hist_percentile(held, pct));
+}
+
+static void text_break_hist(char *name, char *reason, char *state, struct histogram *h)
+{
+	printf("%s break %s%s: %llu breaks, ns p50 %.0f p99 %.0f p99.9 %.0f max %.0f\n",
+	       name, reason, state, h->count,
+	       tsc_to_ns(hist_percentile(h, 50)), tsc_to_ns(hist_percentile(h, 99)),
+	       tsc_to_ns(hist_percentile(h, 99.9)), tsc_to_ns(h->max));
+}
+
+static void json_break_hist(char *key, struct histogram *h)
+{
+	printf("\"%s\": {\"count\": %llu, \"p50\": %.0f, \"p99\": %.0f, ",
+	       key, h->count, tsc_to_ns(hist_percentile(h, 50)), tsc_to_ns(hist_percentile(h, 99)));
+	printf("\"p99.9\": %.0f, \"max\": %.0f}",
+	       tsc_to_ns(hist_percentile(h, 99.9)), tsc_to_ns(h->max));
+}
+
+static void csv_break_hist(struct histogram *h)
+{
+	printf("%llu,%.0f,%.0f,%.0f,%.0f",
+	       h->count, tsc_to_ns(hist_percentile(h, 50)), tsc_to_ns(hist_percentile(h, 99)),
+	       tsc_to_ns(hist_percentile(h, 99.9)), tsc_to_ns(h->max));
+}
+
+static char *wi_units(struct work_instance *wi)
+{
+	return wi->workload->units ? wi->workload->units : "";
+}
+
+static void report_text(struct work_instance *first)
+{
+	struct histogram *h = hist_alloc();
+	struct histogram *rh = hist_alloc();
+	struct workload *wp;
+	struct summary sum;
+	int reason;
+
+	if (fpu_events)
+		text_fpu_counts(first);
+
+	for (wp = all_workloads; wp; wp = wp->next) {
+		for (reason = BREAK_BY_YIELD; reason <= BREAK_REASON_MAX; reason++) {
+			if (merge_break_hist(first, wp, reason, 0, h))
+				text_break_hist(wp->name, break_reason_names[reason], "", h);
+			if (!merge_break_hist(first, wp, reason, 1, rh))
+				continue;
+			text_break_hist(wp->name, break_reason_names[reason], " released", rh);
+			if (h->count)
+				printf("%s break %s: released - held p50 %+.0f ns p99 %+.0f ns, xstate %u -> %u bytes\n",
+				       wp->name, break_reason_names[reason],
+				       release_delta_ns(h, rh, 50), release_delta_ns(h, rh, 99),
+				       xstate_footprint(merge_xinuse(first, wp, 0)),
+				       xstate_footprint(merge_xinuse(first, wp, 1)));
+		}
+
+		if (summarize(first, wp, &sum) < 2)
+			continue;
+
+		printf("%s: %d threads, clock-cycles min %.0f median %.0f max %.0f\n",
+		       wp->name, sum.num, sum.cycles.min, sum.cycles.median, sum.cycles.max);
+		if (wp->units)
+			printf("%s: %d threads, %s/s min %.6g median %.6g max %.6g\n",
+			       wp->name, sum.num, wp->units, sum.tput.min, sum.tput.median,
+			       sum.tput.max);
+		printf("%s: %d threads, setup sec min %.6f median %.6f max %.6f\n",
+		       wp->name, sum.num, sum.setup.min / 1e9, sum.setup.median / 1e9,
+		       sum.setup.max / 1e9);
+		if (sum.mhz.max)
+			printf("%s: %d threads, core MHz min %.0f median %.0f max %.0f\n",
+			       wp->name, sum.num, sum.mhz.min, sum.mhz.median, sum.mhz.max);
+		if (sum.ipc.max)
+			printf("%s: %d threads, IPC min %.2f median %.2f max %.2f\n",
+			       wp->name, sum.num, sum.ipc.min, sum.ipc.median, sum.ipc.max);
+		if (sum.switches.max)
+			printf("%s: %d threads, context switches/sec min %.1f median %.1f max %.1f\n",
+			       wp->name, sum.num, sum.switches.min, sum.switches.median,
+			       sum.switches.max);
+	}
+
+	if (summarize(first, NULL, &sum) > 1)
+		printf("start skew: %d threads, ns min %.0f median %.0f max %.0f\n",
+		       sum.num, sum.skew.min, sum.skew.median, sum.skew.max);
+	free(rh);
+	free(h);
+}
+
+static void json_stat3(char *name, struct stat3 *st, char *sep)
+{
+	printf("\"%s\": {\"min\": %.6g, \"median\": %.6g, \"max\": %.6g}%s",
+	       name, st->min, st->median, st->max, sep);
+}
+
+static void report_json(struct work_instance *first)
+{
+	struct histogram *h = hist_alloc();
+	struct histogram *rh = hist_alloc();
+	struct work_instance *wi;
+	struct workload *wp;
+	struct summary sum;
+	char name[64];
+	int reason;
+	char *sep;
+
+	printf("{\n");
+	printf("  \"tsc_hz\": %llu,\n", tsc_per_sec);
+	printf("  \"duration_sec\": %g,\n", duration_sec);
+	/* both run at -R, each under its own key */
+	for (wi = first; wi; wi = wi->next)
+		if (wi->break_reason == BREAK_BY_SIGNAL)
+			break;
+	if (wi)
+		printf("  \"signal_hz\": %u,\n", break_hz);
+	for (wi = first; wi; wi = wi->next)
+		if (wi->break_reason == BREAK_BY_FUTEX_GEN)
+			break;
+	if (wi)
+		printf("  \"futex_gen_hz\": %u,\n", break_hz);
+	if (fpu_events)
+		printf("  \"x86_fpu_lost\": %llu,\n", fpu_events_lost);
+	if (release_mode != RELEASE_HOLD)
+		printf("  \"release\": \"%s\",\n", release_mode_names[release_mode]);
+	printf("  \"threads\": [\n");
+	for (wi = first; wi; wi = wi->next) {
+		printf("    {\"workload\": \"%s\", \"thread\": %d, \"cpu\": %d, ",
+		       wi->workload->name, wi->thread_number, wi->last_cpu);
+		printf("\"break_reason\": \"%s\", \"repeat\": %u, ",
+		       break_reason_names[wi->break_reason], wi->repeat);
+		printf("\"cycles\": %llu, \"elapsed_ns\": %.0f, \"start_skew_ns\": %.0f, ",
+		       wi->cycles, wi_elapsed_ns(wi), wi_start_skew_ns(wi));
+		printf("\"work_done\": %llu, \"units\": \"%s\", \"throughput\": %.6g, ",
+		       wi->work_done, wi_units(wi), wi_throughput(wi));
+		printf("\"per_cycle\": %.6g, \"xinuse\": %llu, \"xstate_bytes\": %u, ",
+		       wi_per_cycle(wi), wi->xinuse, xstate_footprint(wi->xinuse));
+		printf("\"peak_per_cycle\": %.6g, \"pct_peak\": %.4g, \"setup_ns\": %.0f, ",
+		       wi->workload->peak_per_cycle, wi_pct_peak(wi), wi_setup_ns(wi));
+		json_break_hist("break_latency_ns", wi->break_hist);
+		if (release_mode != RELEASE_HOLD) {
+			printf(", ");
+			json_break_hist("release_latency_ns", wi->release_hist);
+			printf(", \"release_xinuse\": %llu, \"release_xstate_bytes\": %u",
+			       wi->release_xinuse, xstate_footprint(wi->release_xinuse));
+		}
+		printf(", \"alloc\": \"%s\", \"inputs\": \"%s\", ",
+		       alloc_policy_name(wi->alloc_policy, name, sizeof(name)),
+		       input_mode_name(wi->inputs));
+		printf("\"cache\": \"%s\", \"cache_ns\": %.0f, \"core_mhz\": %.0f, ",
+		       cache_mode_name(cache_mode), wi_cache_ns(wi), core_clock_mhz(wi));
+		printf("\"ipc\": %.4g, \"switches_per_sec\": %.6g, ",
+		       counters_ipc(wi), wi_switches_per_sec(wi));
+		json_counters(wi);
+		if (wi->break_reason == BREAK_BY_SIGNAL)
+			printf(", \"signal_overruns\": %llu", wi->signal_overruns);
+		if (wi->trace_stats.iterations) {
+			printf(", ");
+			json_trace_stats(&wi->trace_stats);
+		}
+		if (fpu_events) {
+			printf(", ");
+			json_fpu_counts(wi);
+		}
+		printf("}%s\n", wi->next ? "," : "");
+	}
+	printf("  ],\n");
+
+	printf("  \"aggregate\": [");
+	sep = "\n";
+	for (wp = all_workloads; wp; wp = wp->next) {
+		if (summarize(first, wp, &sum) == 0)
+			continue;
+
+		printf("%s    {\"workload\": \"%s\", \"threads\": %d, ", sep, wp->name, sum.num);
+		json_stat3("cycles", &sum.cycles, ", ");
+		json_stat3("elapsed_ns", &sum.ns, ", ");
+		json_stat3("setup_ns", &sum.setup, ", ");
+		json_stat3("core_mhz", &sum.mhz, ", ");
+		json_stat3("ipc", &sum.ipc, ", ");
+		json_stat3("switches_per_sec", &sum.switches, ", ");
+		json_stat3("throughput", &sum.tput, "}");
+		sep = ",\n";
+	}
+	printf("\n  ],\n");
+
+	printf("  \"break_latency\": [");
+	sep = "\n";
+	for (wp = all_workloads; wp; wp = wp->next) {
+		for (reason = BREAK_BY_YIELD; reason <= BREAK_REASON_MAX; reason++) {
+			if (merge_break_hist(first, wp, reason, 0, h)) {
+				printf("%s    {\"workload\": \"%s\", \"break_reason\": \"%s\", ",
+				       sep, wp->name, break_reason_names[reason]);
+				json_break_hist("break_latency_ns", h);
+				printf("}");
+				sep = ",\n";
+			}
+			if (merge_break_hist(first, wp, reason, 1, rh) == 0)
+				continue;
+
+			printf("%s    {\"workload\": \"%s\", \"break_reason\": \"%s\", \"released\": true, ",
+			       sep, wp->name, break_reason_names[reason]);
+			json_break_hist("break_latency_ns", rh);
+			if (h->count)
+				printf(", \"delta_p50_ns\": %.0f, \"delta_p99_ns\": %.0f",
+				       release_delta_ns(h, rh, 50), release_delta_ns(h, rh, 99));
+			printf("}");
+			sep = ",\n";
+		}
+	}
+	printf("\n  ],\n");
+
+	printf("  ");
+	if (summarize(first, NULL, &sum))
+		json_stat3("start_skew_ns", &sum.skew, "\n");
+	else
+		printf("\"start_skew_ns\": null\n");
+	printf("}\n");
+	free(rh);
+	free(h);
+}
+
+static void report_csv(struct work_instance *first)
+{
+	struct histogram *h = hist_alloc();
+	struct work_instance *wi;
+	struct workload *wp;
+	struct summary sum;
+	char name[64];
+	int reason;
+
+	printf("record,workload,thread,cpu,break_reason,repeat,cycles,elapsed_ns,start_skew_ns,");
+	printf("work_done,units,throughput,");
+	printf("break_count,break_p50_ns,break_p99_ns,break_p999_ns,break_max_ns,alloc,");
+	printf("per_cycle,xinuse,xstate_bytes,peak_per_cycle,pct_peak,setup_ns,inputs,cache,cache_ns,");
+	printf("trace_iterations,trace_median_ns,trace_outliers,trace_max_ns,core_mhz,");
+	printf("ipc,switches_per_sec,xsaves,xrstors\n");
+	for (wi = first; wi; wi = wi->next) {
+		printf("thread,%s,%d,%d,%s,%u,%llu,%.0f,%.0f,%llu,%s,%.6g,",
+		       wi->workload->name, wi->thread_number, wi->last_cpu,
+		       break_reason_names[wi->break_reason], wi->repeat,
+		       wi->cycles, wi_elapsed_ns(wi), wi_start_skew_ns(wi),
+		       wi->work_done, wi_units(wi), wi_throughput(wi));
+		csv_break_hist(wi->break_hist);
+		printf(",\"%s\",%.6g,0x%llx,%u,%.6g,%.4g,%.0f,%s,%s,%.0f,",
+		       alloc_policy_name(wi->alloc_policy, name, sizeof(name)),
+		       wi_per_cycle(wi), wi->xinuse, xstate_footprint(wi->xinuse),
+		       wi->workload->peak_per_cycle, wi_pct_peak(wi), wi_setup_ns(wi),
+		       input_mode_name(wi->inputs), cache_mode_name(cache_mode), wi_cache_ns(wi));
+		if (wi->trace_stats.iterations)
+			printf("%llu,%.0f,%llu,%.0f,", wi->trace_stats.iterations,
+			       tsc_to_ns(wi->trace_stats.median), wi->trace_stats.outliers,
+			       tsc_to_ns(wi->trace_stats.max));
+		else
+			printf(",,,,");
+		printf("%.0f,%.4g,%.6g,", core_clock_mhz(wi), counters_ipc(wi),
+		       wi_switches_per_sec(wi));
+		if (fpu_events)
+			printf("%llu,%llu\n", wi->xsaves, wi->xrstors);
+		else
+			printf(",\n");
+	}
+
+	/* aggregate rows leave the per-thread columns empty */
+	for (wp = all_workloads; wp; wp = wp->next) {
+		char *units = wp->units ? wp->units : "";
+
+		if (summarize(first, wp, &sum) == 0)
+			continue;
+
+		printf("min,%s,,,,,%.0f,%.0f,%.0f,,%s,%.6g,,,,,,,,,,,,%.0f,,,,,,,,%.0f,%.4g,%.6g,,\n",
+		       wp->name, sum.cycles.min, sum.ns.min, sum.skew.min, units, sum.tput.min,
+		       sum.setup.min, sum.mhz.min, sum.ipc.min, sum.switches.min);
+		printf("median,%s,,,,,%.0f,%.0f,%.0f,,%s,%.6g,,,,,,,,,,,,%.0f,,,,,,,,%.0f,%.4g,%.6g,,\n",
+		       wp->name, sum.cycles.median, sum.ns.median, sum.skew.median, units,
+		       sum.tput.median, sum.setup.median, sum.mhz.median, sum.ipc.median,
+		       sum.switches.median);
+		printf("max,%s,,,,,%.0f,%.0f,%.0f,,%s,%.6g,,,,,,,,,,,,%.0f,,,,,,,,%.0f,%.4g,%.6g,,\n",
+		       wp->name, sum.cycles.max, sum.ns.max, sum.skew.max, units, sum.tput.max,
+		       sum.setup.max, sum.mhz.max, sum.ipc.max, sum.switches.max);
+
+		/* thread_break() latency merged across the workload's threads */
+		for (reason = BREAK_BY_YIELD; reason <= BREAK_REASON_MAX; reason++) {
+			if (merge_break_hist(first, wp, reason, 0, h)) {
+				printf("merged,%s,,,%s,,,,,,,,", wp->name, break_reason_names[reason]);
+				csv_break_hist(h);
+				printf(",,,,,,,,,,,,,,,,,,,\n");
+			}
+			/* -Z: the breaks after xstate_release() */
+			if (merge_break_hist(first, wp, reason, 1, h)) {
+				printf("merged,%s,,,%s_released,,,,,,,,", wp->name,
+				       break_reason_names[reason]);
+				csv_break_hist(h);
+				printf(",,,,,,,,,,,,,,,,,,,\n");
+			}
+		}
+	}
+	free(h);
+}
+
+void report_results(struct work_instance *first)
+{
+	switch (output_format) {
+	case FORMAT_JSON:
+		report_json(first);
+		break;
+	case FORMAT_CSV:
+		report_csv(first);
+		break;
+	default:
+		report_text(first);
+		break;
+	}
+	fflush(stdout);
+}
+
+struct sweep_point {
+	unsigned int bytes;
+	struct workload *wp;
+	int threads;
+	double tput;		/* median per thread */
+	double tput_total;	/* sum over threads */
+};
+
+static struct sweep_point *sweep_points;
+static int num_sweep_points;
+
+/*
+ * sweep_record()
+ * keep the throughput of each workload in this run
+ * as the sweep point for working-set size bytes
+ */
+void sweep_record(struct work_instance *first, unsigned int bytes)
+{
+	struct work_instance *wi;
+	struct workload *wp;
+	struct summary sum;
+
+	for (wp = all_workloads; wp; wp = wp->next) {
+		struct sweep_point *sp;
+
+		if (summarize(first, wp, &sum) == 0)
+			continue;
+
+		sweep_points = realloc(sweep_points, sizeof(struct sweep_point) * (num_sweep_points + 1));
+		if (!sweep_points)
+			err(1, "sweep");
+
+		sp = &sweep_points[num_sweep_points++];
+		sp->bytes = bytes;
+		sp->wp = wp;
+		sp->threads = sum.num;
+		sp->tput = sum.tput.median;
+		sp->tput_total = 0;
+		for (wi = first; wi; wi = wi->next)
+			if (wi->workload == wp)
+				sp->tput_total += wi_throughput(wi);
+	}
+}
+
+/* time for one unit of work on one thread, the latency for MEM_CHASE */
+static double sweep_ns_per_unit(struct sweep_point *sp)
+{
+	return sp->tput ? 1e9 / sp->tput : 0;
+}
+
+static char *sweep_units(struct sweep_point *sp)
+{
+	return sp->wp->units ? sp->wp->units : "";
+}
+
+static char *size_name(unsigned long bytes, char *buf, int len)
+{
+	if (bytes >= 1024 * 1024 && bytes % (1024 * 1024) == 0)
+		snprintf(buf, len, "%luM", bytes / 1024 / 1024);
+	else
+		snprintf(buf, len, "%luK", bytes / 1024);
+	return buf;
+}
+
+static void report_sweep_text(struct cache_sizes *cs)
+{
+	char l1d[32], l2[32], llc[32], size[32];
+	int i;
+
+	printf("sweep: L1d %s L2 %s LLC %s\n", size_name(cs->l1d, l1d, sizeof(l1d)),
+	       size_name(cs->l2, l2, sizeof(l2)), size_name(cs->llc, llc, sizeof(llc)));
+
+	for (i = 0; i < num_sweep_points; i++) {
+		struct sweep_point *sp = &sweep_points[i];
+
+		printf("sweep %s %s: %d threads, %.6g %s/s per thread, %.6g %s/s total, %.4g ns/%s\n",
+		       sp->wp->name, size_name(sp->bytes, size, sizeof(size)), sp->threads,
+		       sp->tput, sweep_units(sp), sp->tput_total, sweep_units(sp),
+		       sweep_ns_per_unit(sp), sweep_units(sp));
+	}
+}
+
+static void report_sweep_json(struct cache_sizes *cs)
+{
+	int i;
+
+	printf("{\n");
+	printf("  \"tsc_hz\": %llu,\n", tsc_per_sec);
+	printf("  \"duration_sec\": %g,\n", duration_sec);
+	printf("  \"cache_bytes\": {\"l1d\": %lu, \"l2\": %lu, \"llc\": %lu},\n",
+	       cs->l1d, cs->l2, cs->llc);
+	printf("  \"sweep\": [\n");
+	for (i = 0; i < num_sweep_points; i++) {
+		struct sweep_point *sp = &sweep_points[i];
+
+		printf("    {\"workload\": \"%s\", \"bytes\": %u, \"threads\": %d, ",
+		       sp->wp->name, sp->bytes, sp->threads);
+		printf("\"units\": \"%s\", \"throughput\": %.6g, \"throughput_total\": %.6g, ",
+		       sweep_units(sp), sp->tput, sp->tput_total);
+		printf("\"ns_per_unit\": %.6g}%s\n",
+		       sweep_ns_per_unit(sp), i + 1 < num_sweep_points ? "," : "");
+	}
+	printf("  ]\n");
+	printf("}\n");
+}
+
+static void report_sweep_csv(void)
+{
+	int i;
+
+	printf("workload,bytes,threads,units,throughput,throughput_total,ns_per_unit\n");
+	for (i = 0; i < num_sweep_points; i++) {
+		struct sweep_point *sp = &sweep_points[i];
+
+		printf("%s,%u,%d,%s,%.6g,%.6g,%.6g\n",
+		       sp->wp->name, sp->bytes, sp->threads, sweep_units(sp),
+		       sp->tput, sp->tput_total, sweep_ns_per_unit(sp));
+	}
+}
+
+/*
+ * report_sweep()
+ * throughput and ns per unit versus working-set size,
+ * one point per workload per sweep_record()
+ */
+void report_sweep(struct cache_sizes *cs)
+{
+	switch (output_format) {
+	case FORMAT_JSON:
+		report_sweep_json(cs);
+		break;
+	case FORMAT_CSV:
+		report_sweep_csv();
+		break;
+	default:
+		report_sweep_text(cs);
+		break;
+	}
+	fflush(stdout);
+
+	free(sweep_points);
+	sweep_points = NULL;
+	num_sweep_points = 0;
+}
+
+struct oversub_solo {
+	struct workload *wp;
+	double tput;		/* units per second, alone on the CPU */
+	double rate;		/* units per CPU second */
+	double switch_rate;	/* context switches per CPU second */
+};
+
+static struct oversub_solo *oversub_solos;
+static int num_oversub_solos;
+
+static struct oversub_solo *find_solo(struct workload *wp)
+{
+	int i;
+
+	for (i = 0; i < num_oversub_solos; i++)
+		if (oversub_solos[i].wp == wp)
+			return &oversub_solos[i];
+	return NULL;
+}
+
+int oversub_solo_done(struct workload *wp)
+{
+	return find_solo(wp) != NULL;
+}
+
+/* keep the rates of wi, which ran alone on its CPU */
+void oversub_record_solo(struct work_instance *wi)
+{
+	struct oversub_solo *so;
+
+	oversub_solos = realloc(oversub_solos, sizeof(struct oversub_solo) * (num_oversub_solos + 1));
+	if (!oversub_solos)
+		err(1, "oversub");
+
+	so = &oversub_solos[num_oversub_solos++];
+	so->wp = wi->workload;
+	so->tput = wi_throughput(wi);
+	so->rate = wi->cpu_ns ? wi->work_done * 1e9 / wi->cpu_ns : 0;
+	so->switch_rate = wi->cpu_ns ? wi->ctr[CTR_SWITCHES] * 1e9 / wi->cpu_ns : 0;
+}
+
+struct oversub_point {
+	struct work_instance *wi;
+	struct oversub_solo *so;
+	double loss_pct;	/* throughput below alone */
+	double fair_loss_pct;	/* throughput below 1/per_cpu of alone */
+	double overhead_ns;	/* CPU time beyond what the work took alone */
+	double extra_switches;	/* context switches beyond the rate alone */
+	double switch_ns;	/* overhead_ns per extra switch, if measured */
+	int measured;		/* switch_ns stands out from the noise */
+};
+
+/* with fewer extra switches than this, their cost is lost in the noise */
+#define OVERSUB_MIN_SWITCHES	10
+
+/*
+ * oversub_point()
+ * what sharing a CPU cost wi: its CPU time minus the CPU time its work
+ * took alone, spread over the context switches it had beyond those alone
+ */
+static void oversub_point(struct work_instance *wi, int per_cpu, struct oversub_point *op)
+{
+	struct oversub_solo *so = find_solo(wi->workload);
+
+	memset(op, 0, sizeof(*op));
+	op->wi = wi;
+	op->so = so;
+	if (!so->tput || !so->rate)
+		return;
+
+	op->loss_pct = (1 - wi_throughput(wi) / so->tput) * 100;
+	op->fair_loss_pct = (1 - wi_throughput(wi) * per_cpu / so->tput) * 100;
+	op->overhead_ns = wi->cpu_ns - wi->work_done * 1e9 / so->rate;
+	if (counted(wi, CTR_SWITCHES))
+		op->extra_switches = wi->ctr[CTR_SWITCHES] - so->switch_rate * wi->cpu_ns / 1e9;
+	/* faster than its work took alone, or hardly switched: no cost to see */
+	if (op->overhead_ns <= 0 || op->extra_switches < OVERSUB_MIN_SWITCHES)
+		return;
+	op->switch_ns = op->overhead_ns / op->extra_switches;
+	op->measured = 1;
+}
+
+/* context switches per second across all workers */
+static double oversub_switch_rate(struct work_instance *first)
+{
+	unsigned long long switches = 0;
+	struct work_instance *wi;
+	double ns = 0;
+
+	for (wi = first; wi; wi = wi->next) {
+		switches += wi->ctr[CTR_SWITCHES];
+		if (wi_elapsed_ns(wi) > ns)
+			ns = wi_elapsed_ns(wi);
+	}
+	return ns ? switches * 1e9 / ns : 0;
+}
+
+/* the oversub points of wp's workers, return how many */
+static int collect_oversub(struct work_instance *first, struct workload *wp, int per_cpu,
+			   struct oversub_point *op)
+{
+	struct work_instance *wi;
+	int n = 0;
+
+	for (wi = first; wi; wi = wi->next)
+		if (wi->workload == wp)
+			oversub_point(wi, per_cpu, &op[n++]);
+	return n;
+}
+
+static struct stat3 oversub_stat3(struct oversub_point *op, int n, size_t offset, double *v)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		v[i] = *(double *)((char *)&op[i] + offset);
+	return get_stat3(v, i);
+}
+
+/* switch_ns of the measured points, return how many there were */
+static int oversub_switch_stat3(struct oversub_point *op, int n, double *v, struct stat3 *st)
+{
+	int i, m = 0;
+
+	for (i = 0; i < n; i++)
+		if (op[i].measured)
+			v[m++] = op[i].switch_ns;
+	if (m)
+		*st = get_stat3(v, m);
+	return m;
+}
+
+static void report_oversub_text(struct work_instance *first, int per_cpu, int num_cpus,
+				struct oversub_point *op, double *v)
+{
+	struct work_instance *wi;
+	struct workload *wp;
+	int n;
+
+	for (wi = first; wi; wi = wi->next) {
+		oversub_point(wi, per_cpu, op);
+		printf("oversub %s thread %d CPU %d: %.6g %s/s, %.1f%% below alone, %.1f%% below 1/%d of it, ",
+		       wi->workload->name, wi->thread_number, wi->cpu, wi_throughput(wi), wi_units(wi),
+		       op->loss_pct, op->fair_loss_pct, per_cpu);
+		printf("%llu switches, ", wi->ctr[CTR_SWITCHES]);
+		if (op->measured)
+			printf("%.0f ns per switch, ", op->switch_ns);
+		else
+			printf("ns per switch n/a (noise), ");
+		printf("xstate %u bytes\n", xstate_footprint(wi->xinuse));
+	}
+
+	for (wp = all_workloads; wp; wp = wp->next) {
+		struct stat3 fair, sw;
+		int m;
+
+		n = collect_oversub(first, wp, per_cpu, op);
+		if (!n)
+			continue;
+		fair = oversub_stat3(op, n, offsetof(struct oversub_point, fair_loss_pct), v);
+		printf("oversub %s: %d threads, alone %.6g %s/s, %% below 1/%d of it median %.1f, ",
+		       wp->name, n, op[0].so->tput, wp->units ? wp->units : "", per_cpu,
+		       fair.median);
+		m = oversub_switch_stat3(op, n, v, &sw);
+		if (m)
+			printf("ns per switch of %d measured min %.0f median %.0f max %.0f\n",
+			       m, sw.min, sw.median, sw.max);
+		else
+			printf("ns per switch n/a (noise)\n");
+	}
+
+	printf("oversub: %d threads on each of %d CPUs, %.0f context switches/sec total\n",
+	       per_cpu, num_cpus, oversub_switch_rate(first));
+}
+
+static void report_oversub_json(struct work_instance *first, int per_cpu, int num_cpus,
+				struct oversub_point *op, double *v)
+{
+	struct work_instance *wi;
+	struct workload *wp;
+	char *sep;
+	int n;
+
+	printf("{\n");
+	printf("  \"tsc_hz\": %llu,\n", tsc_per_sec);
+	printf("  \"duration_sec\": %g,\n", duration_sec);
+	printf("  \"threads_per_cpu\": %d,\n", per_cpu);
+	printf("  \"cpus\": %d,\n", num_cpus);
+	printf("  \"switches_per_sec\": %.6g,\n", oversub_switch_rate(first));
+	printf("  \"threads\": [\n");
+	for (wi = first; wi; wi = wi->next) {
+		oversub_point(wi, per_cpu, op);
+		printf("    {\"workload\": \"%s\", \"thread\": %d, \"cpu\": %d, \"units\": \"%s\", ",
+		       wi->workload->name, wi->thread_number, wi->cpu, wi_units(wi));
+		printf("\"throughput\": %.6g, \"solo_throughput\": %.6g, \"loss_pct\": %.4g, ",
+		       wi_throughput(wi), op->so->tput, op->loss_pct);
+		printf("\"fair_loss_pct\": %.4g, \"cpu_ns\": %llu, \"overhead_ns\": %.0f, ",
+		       op->fair_loss_pct, wi->cpu_ns, op->overhead_ns);
+		printf("\"switches\": %llu, ", wi->ctr[CTR_SWITCHES]);
+		if (op->measured)
+			printf("\"ns_per_switch\": %.0f, ", op->switch_ns);
+		else
+			printf("\"ns_per_switch\": null, ");
+		printf("\"xstate_bytes\": %u}%s\n", xstate_footprint(wi->xinuse),
+		       wi->next ? "," : "");
+	}
+	printf("  ],\n");
+
+	printf("  \"aggregate\": [");
+	sep = "\n";
+	for (wp = all_workloads; wp; wp = wp->next) {
+		struct stat3 st;
+
+		n = collect_oversub(first, wp, per_cpu, op);
+		if (!n)
+			continue;
+		printf("%s    {\"workload\": \"%s\", \"threads\": %d, \"solo_throughput\": %.6g, ",
+		       sep, wp->name, n, op[0].so->tput);
+		st = oversub_stat3(op, n, offsetof(struct oversub_point, loss_pct), v);
+		json_stat3("loss_pct", &st, ", ");
+		st = oversub_stat3(op, n, offsetof(struct oversub_point, fair_loss_pct), v);
+		json_stat3("fair_loss_pct", &st, ", ");
+		if (oversub_switch_stat3(op, n, v, &st))
+			json_stat3("ns_per_switch", &st, "}");
+		else
+			printf("\"ns_per_switch\": null}");
+		sep = ",\n";
+	}
+	printf("\n  ]\n");
+	printf("}\n");
+}
+
+static void report_oversub_csv(struct work_instance *first, int per_cpu,
+			       struct oversub_point *op, double *v)
+{
+	struct work_instance *wi;
+	struct workload *wp;
+	int n;
+
+	printf("record,workload,thread,cpu,threads_per_cpu,units,solo_throughput,throughput,");
+	printf("loss_pct,fair_loss_pct,cpu_ns,overhead_ns,switches,ns_per_switch,xstate_bytes\n");
+	for (wi = first; wi; wi = wi->next) {
+		oversub_point(wi, per_cpu, op);
+		printf("thread,%s,%d,%d,%d,%s,%.6g,%.6g,%.4g,%.4g,%llu,%.0f,%llu,",
+		       wi->workload->name, wi->thread_number, wi->cpu, per_cpu, wi_units(wi),
+		       op->so->tput, wi_throughput(wi), op->loss_pct, op->fair_loss_pct,
+		       wi->cpu_ns, op->overhead_ns, wi->ctr[CTR_SWITCHES]);
+		/* empty when not measured */
+		if (op->measured)
+			printf("%.0f", op->switch_ns);
+		printf(",%u\n", xstate_footprint(wi->xinuse));
+	}
+
+	/* median rows leave the per-thread columns empty */
+	for (wp = all_workloads; wp; wp = wp->next) {
+		struct stat3 loss, fair, sw;
+
+		n = collect_oversub(first, wp, per_cpu, op);
+		if (!n)
+			continue;
+		loss = oversub_stat3(op, n, offsetof(struct oversub_point, loss_pct), v);
+		fair = oversub_stat3(op, n, offsetof(struct oversub_point, fair_loss_pct), v);
+		printf("median,%s,,,%d,%s,%.6g,,%.4g,%.4g,,,,",
+		       wp->name, per_cpu, wp->units ? wp->units : "", op[0].so->tput,
+		       loss.median, fair.median);
+		if (oversub_switch_stat3(op, n, v, &sw))
+			printf("%.0f", sw.median);
+		printf(",\n");
+	}
+}
+
+/*
+ * report_oversub()
+ * throughput lost by each thread sharing its CPU with per_cpu - 1 others,
+ * against the same workload alone, and the cost per context switch
+ */
+void report_oversub(struct work_instance *first, int per_cpu, int num_cpus)
+{
+	struct oversub_point *op;
+	struct work_instance *wi;
+	double *v;
+	int n = 0;
+
+	for (wi = first; wi; wi = wi->next)
+		n++;
+	op = malloc(sizeof(struct oversub_point) * n);
+	v = malloc(sizeof(double) * n);
+	if (!op || !v)
+		err(1, "oversub");
+
+	switch (output_format) {
+	case FORMAT_JSON:
+		report_oversub_json(first, per_cpu, num_cpus, op, v);
+		break;
+	case FORMAT_CSV:
+		report_oversub_csv(first, per_cpu, op, v);
+		break;
+	default:
+		report_oversub_text(first, per_cpu, num_cpus, op, v);
+		break;
+	}
+	fflush(stdout);
+
+	free(v);
+	free(op);
+	free(oversub_solos);
+	oversub_solos = NULL;
+	num_oversub_solos = 0;
+}
+
+struct pair_solo {
+	struct workload *wp;
+	double tput;		/* units per second, its sibling idle */
+};
+
+struct pair_point {
+	struct workload *wp;
+	struct workload *sibling;	/* what ran on the other SMT thread */
+	double tput;
+};
+
+static struct pair_solo *pair_solos;
+static int num_pair_solos;
+static struct pair_point *pair_points;
+static int num_pair_points;
+
+/* keep the throughput of wi, which ran with its sibling idle */
+void pair_record_solo(struct work_instance *wi)
+{
+	pair_solos = realloc(pair_solos, sizeof(struct pair_solo) * (num_pair_solos + 1));
+	if (!pair_solos)
+		err(1, "pair");
+
+	pair_solos[num_pair_solos].wp = wi->workload;
+	pair_solos[num_pair_solos].tput = wi_throughput(wi);
+	num_pair_solos++;
+}
+
+/* keep the throughput of wi, which ran with sibling on the other SMT thread */
+void pair_record(struct work_instance *wi, struct work_instance *sibling)
+{
+	struct pair_point *pp;
+
+	pair_points = realloc(pair_points, sizeof(struct pair_point) * (num_pair_points + 1));
+	if (!pair_points)
+		err(1, "pair");
+
+	pp = &pair_points[num_pair_points++];
+	pp->wp = wi->workload;
+	pp->sibling = sibling->workload;
+	pp->tput = wi_throughput(wi);
+}
+
+/* mean throughput of wp next to sibling, two points on the diagonal */
+static double pair_tput(struct workload *wp, struct workload *sibling)
+{
+	double sum = 0;
+	int i, n = 0;
+
+	for (i = 0; i < num_pair_points; i++) {
+		if (pair_points[i].wp == wp && pair_points[i].sibling == sibling) {
+			sum += pair_points[i].tput;
+			n++;
+		}
+	}
+	return n ? sum / n : 0;
+}
+
+/* percent of its throughput alone that wp kept next to sibling, < 0 without units */
+static double pair_retention(struct pair_solo *so, struct workload *sibling)
+{
+	if (!so->tput)
+		return -1;
+
+	return pair_tput(so->wp, sibling) / so->tput * 100;
+}
+
+static void report_pair_text(int pair[2])
+{
+	int i, j;
+
+	printf("pair: CPU %d and CPU %d share a core\n", pair[0], pair[1]);
+	for (i = 0; i < num_pair_solos; i++)
+		printf("pair %s alone: %.6g %s/s\n", pair_solos[i].wp->name, pair_solos[i].tput,
+		       pair_solos[i].wp->units ? pair_solos[i].wp->units : "");
+
+	printf("pair: %% of alone kept by the row workload, with the column workload on its sibling\n");
+	printf("%-12s", "");
+	for (j = 0; j < num_pair_solos; j++)
+		printf(" %11s", pair_solos[j].wp->name);
+	printf("\n");
+	for (i = 0; i < num_pair_solos; i++) {
+		printf("%-12s", pair_solos[i].wp->name);
+		for (j = 0; j < num_pair_solos; j++) {
+			double r = pair_retention(&pair_solos[i], pair_solos[j].wp);
+
+			if (r < 0)
+				printf(" %11s", "-");
+			else
+				printf(" %10.1f%%", r);
+		}
+		printf("\n");
+	}
+}
+
+static void report_pair_json(int pair[2])
+{
+	int i, j;
+
+	printf("{\n");
+	printf("  \"tsc_hz\": %llu,\n", tsc_per_sec);
+	printf("  \"duration_sec\": %g,\n", duration_sec);
+	printf("  \"cpus\": [%d, %d],\n", pair[0], pair[1]);
+	printf("  \"workloads\": [\n");
+	for (i = 0; i < num_pair_solos; i++)
+		printf("    {\"workload\": \"%s\", \"units\": \"%s\", \"solo_throughput\": %.6g}%s\n",
+		       pair_solos[i].wp->name,
+		       pair_solos[i].wp->units ? pair_solos[i].wp->units : "",
+		       pair_solos[i].tput, i + 1 < num_pair_solos ? "," : "");
+	printf("  ],\n");
+	printf("  \"pairs\": [\n");
+	for (i = 0; i < num_pair_solos; i++) {
+		for (j = 0; j < num_pair_solos; j++) {
+			struct workload *sibling = pair_solos[j].wp;
+
+			printf("    {\"workload\": \"%s\", \"sibling\": \"%s\", ",
+			       pair_solos[i].wp->name, sibling->name);
+			printf("\"throughput\": %.6g, ", pair_tput(pair_solos[i].wp, sibling));
+			if (pair_retention(&pair_solos[i], sibling) < 0)
+				printf("\"retention_pct\": null}");
+			else
+				printf("\"retention_pct\": %.4g}",
+				       pair_retention(&pair_solos[i], sibling));
+			printf("%s\n", i + 1 < num_pair_solos || j + 1 < num_pair_solos ? "," : "");
+		}
+	}
+	printf("  ]\n");
+	printf("}\n");
+}
+
+static void report_pair_csv(int pair[2])
+{
+	int i, j;
+
+	printf("record,workload,sibling,cpu,sibling_cpu,units,solo_throughput,throughput,retention_pct\n");
+	for (i = 0; i < num_pair_solos; i++) {
+		for (j = 0; j < num_pair_solos; j++) {
+			struct workload *sibling = pair_solos[j].wp;
+
+			printf("pair,%s,%s,%d,%d,%s,%.6g,%.6g,",
+			       pair_solos[i].wp->name, sibling->name, pair[0], pair[1],
+			       pair_solos[i].wp->units ? pair_solos[i].wp->units : "",
+			       pair_solos[i].tput, pair_tput(pair_solos[i].wp, sibling));
+			/* empty without units */
+			if (pair_retention(&pair_solos[i], sibling) >= 0)
+				printf("%.4g", pair_retention(&pair_solos[i], sibling));
+			printf("\n");
+		}
+	}
+}
+
+/*
+ * report_pair()
+ * the SMT interference matrix: the throughput each workload kept,
+ * against its own alone, with every workload on the sibling thread
+ */
+void report_pair(int pair[2])
+{
+	switch (output_format) {
+	case FORMAT_JSON:
+		report_pair_json(pair);
+		break;
+	case FORMAT_CSV:
+		report_pair_csv(pair);
+		break;
+	default:
+		report_pair_text(pair);
+		break;
+	}
+	fflush(stdout);
+
+	free(pair_solos);
+	pair_solos = NULL;
+	num_pair_solos = 0;
+	free(pair_points);
+	pair_points = NULL;
+	num_pair_points = 0;
+}
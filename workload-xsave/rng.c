@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * rng.c - counter-based random fill for workload input buffers
+ *
+ * Word i of a buffer is rng_u32(key, i). No state carries from one word
+ * to the next, so workers never share a generator (random(3) takes a lock
+ * per call), and every vector lane computes its own word independently.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+#include "yogini.h"
+
+__attribute__((target("avx512f")))
+static inline __m512i mix32_avx512(__m512i x)
+{
+	x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+	x = _mm512_mullo_epi32(x, _mm512_set1_epi32(RNG_MIX_C1));
+	x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 13));
+	x = _mm512_mullo_epi32(x, _mm512_set1_epi32(RNG_MIX_C2));
+	return _mm512_xor_si512(x, _mm512_srli_epi32(x, 16));
+}
+
+/* return the number of words filled, a multiple of 16 */
+__attribute__((target("avx512f")))
+static size_t fill_avx512(uint32_t *p, size_t n, uint32_t key)
+{
+	__m512i ctr = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+					8, 9, 10, 11, 12, 13, 14, 15);
+	__m512i k = _mm512_set1_epi32(key);
+	__m512i step = _mm512_set1_epi32(16);
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m512i x = mix32_avx512(_mm512_xor_si512(ctr, k));
+
+		_mm512_storeu_si512(p + i, mix32_avx512(_mm512_add_epi32(x, k)));
+		ctr = _mm512_add_epi32(ctr, step);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mix32_avx2(__m256i x)
+{
+	x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+	x = _mm256_mullo_epi32(x, _mm256_set1_epi32(RNG_MIX_C1));
+	x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 13));
+	x = _mm256_mullo_epi32(x, _mm256_set1_epi32(RNG_MIX_C2));
+	return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+}
+
+/* return the number of words filled, a multiple of 8 */
+__attribute__((target("avx2")))
+static size_t fill_avx2(uint32_t *p, size_t n, uint32_t key)
+{
+	__m256i ctr = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i k = _mm256_set1_epi32(key);
+	__m256i step = _mm256_set1_epi32(8);
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i x = mix32_avx2(_mm256_xor_si256(ctr, k));
+
+		_mm256_storeu_si256((__m256i *)(p + i), mix32_avx2(_mm256_add_epi32(x, k)));
+		ctr = _mm256_add_epi32(ctr, step);
+	}
+	return i;
+}
+
+/*
+ * rng_fill()
+ * fill bytes of buf with the stream selected by key,
+ * the counter wraps after 16GB
+ */
+void rng_fill(void *buf, size_t bytes, uint32_t key)
+{
+	uint32_t *p = buf;
+	size_t n = bytes / sizeof(uint32_t);
+	size_t i = 0;
+
+	if (cpuid.avx512f)
+		i = fill_avx512(p, n, key);
+	else if (cpuid.avx2)
+		i = fill_avx2(p, n, key);
+
+	for (; i < n; i++)
+		p[i] = rng_u32(key, i);
+
+	if (bytes % sizeof(uint32_t)) {
+		uint32_t last = rng_u32(key, n);
+
+		memcpy(p + n, &last, bytes % sizeof(uint32_t));
+	}
+}
+
+/*
+ * rng_fill_normal()
+ * rng_fill(), then keep the sign and mantissa of each element
+ * and give it the exponent in exp, so every element is a normal
+ * number in +-[0.5, 1): no NaN, infinity or denormal in the inputs
+ */
+static void rng_fill_normal(void *buf, size_t bytes, uint32_t key, uint32_t keep, uint32_t exp)
+{
+	uint32_t *p = buf;
+	size_t i;
+
+	rng_fill(buf, bytes, key);
+	for (i = 0; i < bytes / sizeof(uint32_t); i++)
+		p[i] = (p[i] & keep) | exp;
+}
+
+/* bf16: sign, 8-bit exponent of 126, 7-bit mantissa */
+void rng_fill_bf16(void *buf, size_t bytes, uint32_t key)
+{
+	rng_fill_normal(buf, bytes, key, 0x807F807F, 0x3F003F00);
+}
+
+/* fp16: sign, 5-bit exponent of 14, 10-bit mantissa */
+void rng_fill_fp16(void *buf, size_t bytes, uint32_t key)
+{
+	rng_fill_normal(buf, bytes, key, 0x83FF83FF, 0x38003800);
+}
+
+/* fp32: sign, 8-bit exponent of 126, 23-bit mantissa */
+void rng_fill_fp32(void *buf, size_t bytes, uint32_t key)
+{
+	rng_fill_normal(buf, bytes, key, 0x807FFFFF, 0x3F000000);
+}
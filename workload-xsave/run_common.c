@@ -20,22 +20,31 @@ void thread_break(int32_t reason, uint32_t thread_idx);
  * between each chunk, check the time
  * return when requested operations complete, or out of time
  *
- * return operationds completed
+ * return the TSC at completion, operations completed are in wi->work_done
  */
 static unsigned long long run(struct work_instance *wi)
 {
 	unsigned int count;
 	unsigned int operations = wi->repeat;
 	struct thread_data *dp = wi->worker_data;
+	unsigned long long tsc_now;
 
 	if (operations == 0)
 		operations = (~0U);
 
 	for (count = 0; count < operations; count++) {
 		thread_break(wi->break_reason, wi->thread_number);
+		if (cache_mode != CACHE_HOT)
+			cache_state_apply(wi);
 		/* each invocation of work() does "entries" operations */
 		work(dp);
+		trace_record(wi);
+		if (wi->tsc_end && rdtsc() >= wi->tsc_end) {
+			count++;
+			break;
+		}
 	}
-	unsigned long long tsc_now = rdtsc();
+	tsc_now = rdtsc();
+	wi->work_done = (unsigned long long)count * work_size(dp);
 	return tsc_now;
 }
@@ -20,20 +20,27 @@ if [ ! -d "$result_dir" ]; then
 fi
 
 # mode1: test workloads in specific break_reason
+# yogini counts the x86_fpu events itself, and dumps the samples to .bin
 test_single () {
-  echo "trace-cmd record -e x86_fpu -F ./yogini -b $break_reason -r $repeat $option"
-  trace-cmd record -e x86_fpu -F ./yogini -b $break_reason -r $repeat $option
+  dump="${result_dir}/${result}${break_reason}.bin"
+  echo "./yogini -b $break_reason -r $repeat -X $dump $option"
+  ./yogini -b $break_reason -r $repeat -X "$dump" $option > "${result_dir}/${result}${break_reason}"
   if [ $? -ne 0 ]; then
-    echo "Failed to execute trace-cmd record."
+    echo "Failed to execute yogini."
     exit 1
   fi
-  trace-cmd report > "${result_dir}/${result}${break_reason}"
 }
 
 # mode2: test workloads in all break_reason
+# the reasons are numbered from 1 in the order ./yogini -h lists them
 test_all () {
-for ((i=1; i<=5; i++))
+reasons=($(./yogini -h 2>&1 | tr -d '\n ' | sed -n 's/.*--break_reason,\[\([^]]*\)\].*/\1/p' | tr '/' ' '))
+for ((i=1; i<=${#reasons[@]}; i++))
 do
+  if [ "${reasons[i-1]}" == "migrate" ] && [ "$(getconf _NPROCESSORS_ONLN)" -lt 2 ]; then
+    echo "skip break_reason $i (migrate), it needs two CPUs"
+    continue
+  fi
   break_reason=$i
   test_single
 done
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * sweep.c - working-set sizes spanning the cache hierarchy
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <err.h>
+#include "yogini.h"
+
+#define CACHE_SYSFS		"/sys/devices/system/cpu/cpu0/cache"
+#define CACHE_MAX_INDEX		16
+#define SWEEP_STEPS_PER_OCTAVE	2
+/* MEM and memcpy split the working set in two 4KB-copy buffers */
+#define SWEEP_ALIGN		(8 * 1024UL)
+#define SWEEP_MAX_BYTES		(2UL * 1024 * 1024 * 1024)
+
+static int read_cache_attr(int index, char *attr, char *buf, int len)
+{
+	char path[128];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), CACHE_SYSFS "/index%d/%s", index, attr);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (!fgets(buf, len, fp)) {
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+/* "48K", "2048K", "105M" */
+static unsigned long parse_cache_size(char *str)
+{
+	char *end;
+	unsigned long size = strtoul(str, &end, 10);
+
+	switch (*end) {
+	case 'G':
+		size *= 1024;
+		/* fall through */
+	case 'M':
+		size *= 1024;
+		/* fall through */
+	case 'K':
+		size *= 1024;
+	}
+	return size;
+}
+
+/*
+ * read_cache_sizes()
+ * L1d, L2 and last-level cache sizes of cpu0, in bytes
+ * return 0 on success, -1 if L1d or LLC can not be found
+ */
+int read_cache_sizes(struct cache_sizes *cs)
+{
+	char level[16], type[32], size[32];
+	int index, llc_level = 0;
+
+	memset(cs, 0, sizeof(*cs));
+
+	for (index = 0; index < CACHE_MAX_INDEX; index++) {
+		int lvl;
+
+		if (read_cache_attr(index, "level", level, sizeof(level)) ||
+		    read_cache_attr(index, "type", type, sizeof(type)) ||
+		    read_cache_attr(index, "size", size, sizeof(size)))
+			continue;
+		if (strcmp(type, "Instruction") == 0)
+			continue;
+
+		lvl = atoi(level);
+		if (lvl == 1)
+			cs->l1d = parse_cache_size(size);
+		else if (lvl == 2)
+			cs->l2 = parse_cache_size(size);
+		if (lvl >= llc_level) {
+			llc_level = lvl;
+			cs->llc = parse_cache_size(size);
+		}
+	}
+
+	if (!cs->l1d || llc_level < 2)
+		return -1;
+	return 0;
+}
+
+/*
+ * sweep_sizes()
+ * working-set sizes from L1d/2 to 4 * LLC,
+ * SWEEP_STEPS_PER_OCTAVE per power of two, each a multiple of SWEEP_ALIGN
+ * return the number of sizes in *sizes
+ */
+int sweep_sizes(struct cache_sizes *cs, unsigned int **sizes)
+{
+	unsigned long first = cs->l1d / 2;
+	unsigned long last = cs->llc * 4;
+	unsigned long prev = 0;
+	int num = 0, max, step;
+
+	if (last > SWEEP_MAX_BYTES)
+		last = SWEEP_MAX_BYTES;
+	if (first < SWEEP_ALIGN)
+		first = SWEEP_ALIGN;
+
+	max = (log2((double)last / first) + 1) * SWEEP_STEPS_PER_OCTAVE + 1;
+	*sizes = malloc(sizeof(unsigned int) * max);
+	if (!*sizes)
+		err(1, "sweep sizes");
+
+	for (step = 0; num < max; step++) {
+		unsigned long bytes = first * pow(2, (double)step / SWEEP_STEPS_PER_OCTAVE);
+
+		if (bytes > last)
+			bytes = last;
+		bytes = (bytes + SWEEP_ALIGN / 2) / SWEEP_ALIGN * SWEEP_ALIGN;
+		if (bytes != prev)
+			(*sizes)[num++] = bytes;
+		prev = bytes;
+		if (bytes >= last - SWEEP_ALIGN / 2)
+			break;
+	}
+
+	return num;
+}
@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * trace.c - per-iteration TSC trace of each worker
+ *
+ * With -T, each worker gets a preallocated ring of TRACE_ENTRIES TSC stamps,
+ * written by trace_record() after every iteration of its run loop, by that
+ * worker only, so no locking is needed. After the run, the worker finds the
+ * median iteration and flags outliers. main() then dumps all rings to the
+ * trace file as CSV, or as binary if the name ends in ".bin".
+ *
+ * Binary layout, little endian: struct trace_header, then one
+ * struct trace_entry per iteration, thread by thread.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <err.h>
+#include "yogini.h"
+
+#define TRACE_MAGIC	"YOGTRACE"
+/* an outlier is this many MADs above the median, and at least twice it */
+#define TRACE_OUTLIER_MADS	10
+
+char *trace_file;
+
+struct trace_header {
+	char magic[8];
+	uint64_t tsc_hz;
+	uint64_t num_entries;
+};
+
+struct trace_entry {
+	uint32_t thread;
+	uint32_t outlier;
+	uint64_t iteration;
+	uint64_t tsc;		/* at the end of the iteration */
+	uint64_t cycles;	/* of the iteration */
+};
+
+int parse_trace_cmd(char *input_string)
+{
+	if (!*input_string)
+		return -1;
+	trace_file = input_string;
+	return 0;
+}
+
+void trace_alloc(struct work_instance *wi)
+{
+	if (!trace_file)
+		return;
+
+	if (!wi->trace) {
+		wi->trace = malloc(sizeof(unsigned long long) * TRACE_ENTRIES);
+		if (!wi->trace)
+			err(1, "trace");
+		/* fault the ring in now, rather than in the timed loop */
+		memset(wi->trace, 0, sizeof(unsigned long long) * TRACE_ENTRIES);
+	}
+	wi->trace_count = 0;
+}
+
+/* index of the oldest iteration still in the ring */
+static unsigned long long trace_first(struct work_instance *wi)
+{
+	return wi->trace_count > TRACE_ENTRIES ? wi->trace_count - TRACE_ENTRIES : 0;
+}
+
+/* TSC cycles iteration i took, i must still be in the ring */
+static unsigned long long trace_cycles(struct work_instance *wi, unsigned long long i)
+{
+	unsigned long long prev;
+
+	prev = i ? wi->trace[(i - 1) & (TRACE_ENTRIES - 1)] : wi->trace_start;
+	return wi->trace[i & (TRACE_ENTRIES - 1)] - prev;
+}
+
+static int compare_ull(const void *a, const void *b)
+{
+	unsigned long long ua = *(const unsigned long long *)a;
+	unsigned long long ub = *(const unsigned long long *)b;
+
+	return (ua > ub) - (ua < ub);
+}
+
+/*
+ * trace_analyze()
+ * median, outlier threshold, outlier count and the longest iteration
+ * of the iterations still in wi's ring; the first one kept has no
+ * predecessor once the ring has wrapped, so it is skipped
+ */
+void trace_analyze(struct work_instance *wi)
+{
+	struct trace_stats *ts = &wi->trace_stats;
+	unsigned long long first, i, *v, mad;
+	int num = 0;
+
+	memset(ts, 0, sizeof(*ts));
+	if (!wi->trace || !wi->trace_count)
+		return;
+
+	first = trace_first(wi);
+	if (first)
+		first++;
+
+	v = malloc(sizeof(unsigned long long) * (wi->trace_count - first));
+	if (!v)
+		err(1, "trace");
+
+	for (i = first; i < wi->trace_count; i++)
+		v[num++] = trace_cycles(wi, i);
+
+	qsort(v, num, sizeof(*v), compare_ull);
+	ts->median = v[num / 2];
+
+	/* median absolute deviation */
+	for (i = 0; i < num; i++)
+		v[i] = v[i] > ts->median ? v[i] - ts->median : ts->median - v[i];
+	qsort(v, num, sizeof(*v), compare_ull);
+	mad = v[num / 2];
+	free(v);
+
+	ts->threshold = ts->median + TRACE_OUTLIER_MADS * mad;
+	if (ts->threshold < 2 * ts->median)
+		ts->threshold = 2 * ts->median;
+
+	ts->iterations = num;
+	for (i = first; i < wi->trace_count; i++) {
+		unsigned long long cycles = trace_cycles(wi, i);
+
+		if (cycles > ts->threshold)
+			ts->outliers++;
+		if (cycles > ts->max) {
+			ts->max = cycles;
+			ts->max_iteration = i;
+		}
+	}
+}
+
+static void trace_dump_csv(FILE *fp, struct work_instance *first)
+{
+	struct work_instance *wi;
+	unsigned long long i, start;
+
+	fprintf(fp, "thread,workload,break_reason,xstate_bytes,iteration,tsc,ns,cycles,outlier\n");
+	for (wi = first; wi; wi = wi->next) {
+		if (!wi->trace_stats.iterations)
+			continue;
+
+		start = wi->trace_count - wi->trace_stats.iterations;
+		for (i = start; i < wi->trace_count; i++) {
+			unsigned long long tsc = wi->trace[i & (TRACE_ENTRIES - 1)];
+			unsigned long long cycles = trace_cycles(wi, i);
+
+			fprintf(fp, "%d,%s,%s,%u,%llu,%llu,%.0f,%llu,%d\n",
+				wi->thread_number, wi->workload->name,
+				break_reason_names[wi->break_reason], xstate_footprint(wi->xinuse),
+				i, tsc, (double)(tsc - wi->trace_start) * 1e9 / tsc_per_sec,
+				cycles, cycles > wi->trace_stats.threshold);
+		}
+	}
+}
+
+static void trace_dump_bin(FILE *fp, struct work_instance *first)
+{
+	struct trace_header th = { TRACE_MAGIC };
+	struct work_instance *wi;
+	unsigned long long i;
+
+	th.tsc_hz = tsc_per_sec;
+	for (wi = first; wi; wi = wi->next)
+		th.num_entries += wi->trace_stats.iterations;
+	if (fwrite(&th, sizeof(th), 1, fp) != 1)
+		err(1, "%s", trace_file);
+
+	for (wi = first; wi; wi = wi->next) {
+		if (!wi->trace_stats.iterations)
+			continue;
+
+		for (i = wi->trace_count - wi->trace_stats.iterations; i < wi->trace_count; i++) {
+			struct trace_entry te;
+
+			te.thread = wi->thread_number;
+			te.iteration = i;
+			te.tsc = wi->trace[i & (TRACE_ENTRIES - 1)];
+			te.cycles = trace_cycles(wi, i);
+			te.outlier = te.cycles > wi->trace_stats.threshold;
+			if (fwrite(&te, sizeof(te), 1, fp) != 1)
+				err(1, "%s", trace_file);
+		}
+	}
+}
+
+/* write the rings of all workers to trace_file */
+void trace_dump(struct work_instance *first)
+{
+	size_t len;
+	FILE *fp;
+
+	if (!trace_file)
+		return;
+
+	fp = fopen(trace_file, "w");
+	if (!fp)
+		err(1, "%s", trace_file);
+
+	len = strlen(trace_file);
+	if (len > 4 && strcmp(trace_file + len - 4, ".bin") == 0)
+		trace_dump_bin(fp, first);
+	else
+		trace_dump_csv(fp, first);
+
+	if (fclose(fp))
+		err(1, "%s", trace_file);
+}
@@ -21,7 +21,7 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 
-// #pragma GCC target("amx")
+#pragma GCC target("amx-tile,amx-int8")
 #define WORKLOAD_NAME "AMX"
 #define XFEATURE_XTILEDATA 18
 #define ARCH_REQ_XCOMP_PERM 0x1023
@@ -86,6 +86,10 @@ static void set_tiledata_use(void)
 		printf("Fail to do XFEATURE_XTILEDATA\n");
 }
 
+/*
+ * memory-bound AMX: C is loaded and stored around every TMUL,
+ * so this measures tile load/store bandwidth, see work_AMX_GEMM.c for TMUL throughput
+ */
 static void work(void *arg)
 {
 	int i;
@@ -103,6 +107,14 @@ static void work(void *arg)
 	}
 }
 
+/* one 16x16x64 int8 multiply-add per tdpbssd */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (unsigned long long)dp->data_entries * ROW_NUM * (COL_NUM / 4) * COL_NUM * 2;
+}
+
 #include "worker_init_amx.c"
 #include "run_common.c"
 
@@ -111,9 +123,13 @@ static struct workload w = {
 	init,
 	cleanup,
 	run,
+	"ops",
 };
 
 struct workload *register_AMX(void)
 {
-	return &w;
+	if (cpuid.amx_tile && cpuid.amx_int8)
+		return &w;
+
+	return NULL;
 }
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * work_AMX_GEMM.c - offer the "AMX_GEMM_INT8" and "AMX_GEMM_BF16" workloads to yogini
+ *
+ * Unlike "AMX", which loads and stores C around every TMUL and so measures
+ * tile load/store bandwidth, these keep a 2x2 block of C tiles resident in
+ * tmm0-3 and accumulate along K, with A in tmm4-5 and B in tmm6-7:
+ * four TMULs per four 1KB tile loads, and one C store per K loop.
+ *
+ * A and B are kept pre-packed as contiguous 1KB tiles (B in the VNNI layout
+ * TMUL expects), so every tile load is a single 64-byte-stride stream.
+ * The loop walks N in 32-column panels: a panel of B (K x 32, 32KB for INT8)
+ * stays in L1 while all of A streams past it from L2.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>		/* printf(3) */
+#include <stdlib.h>
+#include <immintrin.h>
+#include "yogini.h"
+#include <err.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#pragma GCC target("amx-tile,amx-int8,amx-bf16")
+#define XFEATURE_XTILEDATA 18
+#define ARCH_REQ_XCOMP_PERM 0x1023
+#define ROW_NUM 16
+#define COL_NUM 64
+#define TILE_BYTES	(ROW_NUM * COL_NUM)
+
+/* C is GEMM_M x GEMM_N, A is GEMM_M x GEMM_K, B is GEMM_K x GEMM_N */
+#define GEMM_M		256
+#define GEMM_N		256
+#define GEMM_K		1024
+#define M_TILES		(GEMM_M / ROW_NUM)
+#define N_TILES		(GEMM_N / ROW_NUM)
+
+/* K covered by one tile: 64 int8 or 32 bf16 */
+#define K_PER_TILE_INT8	64
+#define K_PER_TILE_BF16	32
+
+/* TMUL ops, a multiply and an add per MAC, per core clock on Sapphire Rapids */
+#define PEAK_OPS_PER_CYCLE_INT8	2048
+#define PEAK_OPS_PER_CYCLE_BF16	1024
+
+enum { GEMM_INT8, GEMM_BF16 };
+
+struct __tile_config {
+	uint8_t palette_id;
+	uint8_t start_row;
+	uint8_t reserved_0[14];
+	uint16_t colsb[8];
+	uint16_t reserved_1[8];
+	uint8_t rows[8];
+	uint8_t reserved_2[8];
+};
+
+union __union_tile_config {
+	struct __tile_config s;
+	uint8_t a[64];
+};
+
+struct thread_data {
+	int type;
+	int k_tiles;
+	uint8_t *a;		/* [M_TILES][k_tiles] tiles */
+	uint8_t *b;		/* [N_TILES][k_tiles] tiles */
+	uint8_t *c;		/* [M_TILES][N_TILES] tiles */
+};
+
+#define A_TILE(dp, m, k)	((dp)->a + ((size_t)(m) * (dp)->k_tiles + (k)) * TILE_BYTES)
+#define B_TILE(dp, n, k)	((dp)->b + ((size_t)(n) * (dp)->k_tiles + (k)) * TILE_BYTES)
+#define C_TILE(dp, m, n)	((dp)->c + ((size_t)(m) * N_TILES + (n)) * TILE_BYTES)
+
+/* every tile is 16 rows of 64 bytes */
+static void init_tile_config(void)
+{
+	union __union_tile_config cfg = { 0 };
+	int i;
+
+	cfg.s.palette_id = 1;
+	for (i = 0; i < 8; i++) {
+		cfg.s.colsb[i] = COL_NUM;
+		cfg.s.rows[i] = ROW_NUM;
+	}
+
+	/* _tile_loadconfig() only tells the compiler it reads 8 bytes of cfg */
+	asm volatile ("ldtilecfg %0" : : "m" (cfg));
+}
+
+static void set_tiledata_use(void)
+{
+	if (syscall(SYS_arch_prctl, ARCH_REQ_XCOMP_PERM, XFEATURE_XTILEDATA))
+		printf("Fail to do XFEATURE_XTILEDATA\n");
+}
+
+static void gemm_int8(struct thread_data *dp)
+{
+	int m, n, k;
+
+	for (n = 0; n < N_TILES; n += 2) {
+		for (m = 0; m < M_TILES; m += 2) {
+			_tile_zero(0);
+			_tile_zero(1);
+			_tile_zero(2);
+			_tile_zero(3);
+			for (k = 0; k < dp->k_tiles; k++) {
+				_tile_loadd(4, A_TILE(dp, m, k), COL_NUM);
+				_tile_loadd(5, A_TILE(dp, m + 1, k), COL_NUM);
+				_tile_loadd(6, B_TILE(dp, n, k), COL_NUM);
+				_tile_loadd(7, B_TILE(dp, n + 1, k), COL_NUM);
+				_tile_dpbssd(0, 4, 6);
+				_tile_dpbssd(1, 4, 7);
+				_tile_dpbssd(2, 5, 6);
+				_tile_dpbssd(3, 5, 7);
+			}
+			_tile_stored(0, C_TILE(dp, m, n), COL_NUM);
+			_tile_stored(1, C_TILE(dp, m, n + 1), COL_NUM);
+			_tile_stored(2, C_TILE(dp, m + 1, n), COL_NUM);
+			_tile_stored(3, C_TILE(dp, m + 1, n + 1), COL_NUM);
+		}
+	}
+}
+
+static void gemm_bf16(struct thread_data *dp)
+{
+	int m, n, k;
+
+	for (n = 0; n < N_TILES; n += 2) {
+		for (m = 0; m < M_TILES; m += 2) {
+			_tile_zero(0);
+			_tile_zero(1);
+			_tile_zero(2);
+			_tile_zero(3);
+			for (k = 0; k < dp->k_tiles; k++) {
+				_tile_loadd(4, A_TILE(dp, m, k), COL_NUM);
+				_tile_loadd(5, A_TILE(dp, m + 1, k), COL_NUM);
+				_tile_loadd(6, B_TILE(dp, n, k), COL_NUM);
+				_tile_loadd(7, B_TILE(dp, n + 1, k), COL_NUM);
+				_tile_dpbf16ps(0, 4, 6);
+				_tile_dpbf16ps(1, 4, 7);
+				_tile_dpbf16ps(2, 5, 6);
+				_tile_dpbf16ps(3, 5, 7);
+			}
+			_tile_stored(0, C_TILE(dp, m, n), COL_NUM);
+			_tile_stored(1, C_TILE(dp, m, n + 1), COL_NUM);
+			_tile_stored(2, C_TILE(dp, m + 1, n), COL_NUM);
+			_tile_stored(3, C_TILE(dp, m + 1, n + 1), COL_NUM);
+		}
+	}
+}
+
+static void work(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	if (dp->type == GEMM_BF16)
+		gemm_bf16(dp);
+	else
+		gemm_int8(dp);
+}
+
+/* one full GEMM, a multiply and an add per MAC */
+static unsigned long long work_size(void *arg)
+{
+	return 2ULL * GEMM_M * GEMM_N * GEMM_K;
+}
+
+/* bf16 in [-1, 1): the upper half of a float */
+static void init_bf16(void *p, size_t bytes, uint32_t key)
+{
+	uint16_t *bf = p;
+	size_t i;
+
+	for (i = 0; i < bytes / 2; i++) {
+		union { float f; uint32_t u; } v;
+
+		v.f = (int32_t)rng_u32(key, i) / 2147483648.0f;
+		bf[i] = v.u >> 16;
+	}
+}
+
+static int init_gemm(struct work_instance *wi, int type)
+{
+	struct thread_data *dp;
+	size_t a_bytes, b_bytes, c_bytes;
+	input_fill_fn fill;
+
+	dp = (struct thread_data *)calloc(1, sizeof(struct thread_data));
+	if (!dp)
+		err(1, "thread_data");
+
+	dp->type = type;
+	dp->k_tiles = GEMM_K / (type == GEMM_BF16 ? K_PER_TILE_BF16 : K_PER_TILE_INT8);
+
+	a_bytes = (size_t)M_TILES * dp->k_tiles * TILE_BYTES;
+	b_bytes = (size_t)N_TILES * dp->k_tiles * TILE_BYTES;
+	c_bytes = (size_t)M_TILES * N_TILES * TILE_BYTES;
+
+	/* A and B are read-only, may be shared with other workers, see -i */
+	fill = type == GEMM_BF16 ? init_bf16 : rng_fill;
+	dp->a = get_input_buffer(wi, 0, a_bytes, fill);
+	dp->b = get_input_buffer(wi, 1, b_bytes, fill);
+	dp->c = aligned_alloc(COL_NUM, c_bytes);
+	if (!dp->c)
+		err(1, "%s: C", wi->workload->name);
+
+	/* the working set, for -C */
+	cache_state_add(wi, dp->a, a_bytes);
+	cache_state_add(wi, dp->b, b_bytes);
+	cache_state_add(wi, dp->c, c_bytes);
+
+	set_tiledata_use();
+	init_tile_config();
+
+	wi->worker_data = dp;
+
+	return 0;
+}
+
+static int init_int8_gemm(struct work_instance *wi)
+{
+	return init_gemm(wi, GEMM_INT8);
+}
+
+static int init_bf16_gemm(struct work_instance *wi)
+{
+	return init_gemm(wi, GEMM_BF16);
+}
+
+static int cleanup(struct work_instance *wi)
+{
+	struct thread_data *dp = wi->worker_data;
+
+	_tile_release();
+	put_input_buffer(wi, dp->a);
+	put_input_buffer(wi, dp->b);
+	free(dp->c);
+	free(dp);
+	wi->worker_data = NULL;
+
+	return 0;
+}
+
+#include "run_common.c"
+
+static struct workload AMX_GEMM_INT8_workload = {
+	"AMX_GEMM_INT8",
+	init_int8_gemm,
+	cleanup,
+	run,
+	"ops",
+	PEAK_OPS_PER_CYCLE_INT8,
+};
+
+static struct workload AMX_GEMM_BF16_workload = {
+	"AMX_GEMM_BF16",
+	init_bf16_gemm,
+	cleanup,
+	run,
+	"FLOP",
+	PEAK_OPS_PER_CYCLE_BF16,
+};
+
+struct workload *register_AMX_GEMM_INT8(void)
+{
+	if (cpuid.amx_int8)
+		return &AMX_GEMM_INT8_workload;
+
+	return NULL;
+}
+
+struct workload *register_AMX_GEMM_BF16(void)
+{
+	if (cpuid.amx_bf16)
+		return &AMX_GEMM_BF16_workload;
+
+	return NULL;
+}
@@ -38,10 +38,6 @@ static void work(void *arg)
 	int entries = dp->data_entries / sizeof(double);
 
 	for (i = 0; i < entries; ++i) {
-		if (clfulsh) {
-			clflush_range((void *)dp->input_x + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_y + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-		}
 		__m256 vx, vy, voutput;
 
 		vx = _mm256_loadu_ps(dp->input_x + i * DWORD_PER_VECTOR);
@@ -51,6 +47,14 @@ static void work(void *arg)
 	}
 }
 
+/* one add per float lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (dp->data_entries / sizeof(double)) * DWORD_PER_VECTOR;
+}
+
 #include "run_common.c"
 #include "worker_init_avx.c"
 
@@ -59,9 +63,13 @@ static struct workload w = {
 	init,
 	cleanup,
 	run,
+	"FLOP",
 };
 
 struct workload *register_AVX(void)
 {
-	return &w;
+	if (cpuid.avx)
+		return &w;
+
+	return NULL;
 }
@@ -40,10 +40,6 @@ static void work(void *arg)
 	int entries = dp->data_entries / sizeof(double);
 
 	for (i = 0; i < entries; ++i) {
-		if (clfulsh) {
-			clflush_range((void *)dp->input_x + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_y + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-		}
 		__m256i vx, vy, voutput;
 
 		vx = _mm256_loadu_si256((__m256i *)(dp->input_x + i * BYTES_PER_VECTOR));
@@ -53,6 +49,14 @@ static void work(void *arg)
 	}
 }
 
+/* one multiply per byte lane, one add per word lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (dp->data_entries / sizeof(double)) * (BYTES_PER_VECTOR + WORDS_PER_VECTOR);
+}
+
 #include "worker_init_avx2.c"
 #include "run_common.c"
 
@@ -61,9 +65,13 @@ static struct workload w = {
 	init,
 	cleanup,
 	run,
+	"ops",
 };
 
 struct workload *register_AVX2(void)
 {
-	return &w;
+	if (cpuid.avx2 && cpuid.fma)
+		return &w;
+
+	return NULL;
 }
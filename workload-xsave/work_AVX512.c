@@ -26,6 +26,8 @@
 #define BYTES_PER_VECTOR	(BITS_PER_VECTOR / 8)
 #define WORDS_PER_VECTOR        (BITS_PER_VECTOR / 16)
 #define DWORD_PER_VECTOR	(BITS_PER_VECTOR / 32)
+#define DOTPROD_FILL		rng_fill_fp32
+#define DOTPROD_PASS(entries)	((entries) / sizeof(double))
 
 #pragma GCC optimize("unroll-loops")
 
@@ -45,12 +47,6 @@ static void work(void *arg)
 	int entries = dp->data_entries / sizeof(double);
 
 	for (i = 0; i < entries; ++i) {
-		if (clfulsh) {
-			clflush_range((void *)dp->input_x + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_y + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_z + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-		}
-
 		__m512 vx, vy, vz, voutput;
 
 		vx = _mm512_loadu_ps((float *)(dp->input_x + i * BYTES_PER_VECTOR));
@@ -64,6 +60,14 @@ static void work(void *arg)
 	}
 }
 
+/* two bf16 multiply-adds per float lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (dp->data_entries / sizeof(double)) * DWORD_PER_VECTOR * 2 * 2;
+}
+
 #include "worker_init_dotprod.c"
 #include "run_common.c"
 
@@ -72,11 +76,13 @@ static struct workload w = {
 	init,
 	cleanup,
 	run,
+	"FLOP",
 };
 
 struct workload *register_AVX512(void)
 {
-	if (cpuid.avx512f)
+	/* vdpbf16ps and vcvtne2ps2bf16 are AVX512_BF16, not AVX512F */
+	if (cpuid.avx512f && cpuid.avx512_bf16)
 		return &w;
 
 	return NULL;
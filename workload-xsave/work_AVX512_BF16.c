@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * offer the "AVX512_BF16" workload to yogini
+ *
+ * vdpbf16ps on bf16 inputs already in memory, as inference kernels see them.
+ * "AVX512" converts fp32 to bf16 in the loop, so it measures the conversion
+ * as much as the dot product.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>		/* printf(3) */
+#include <stdlib.h>
+#include "yogini.h"
+#include <immintrin.h>
+#include <stdint.h>
+#include <err.h>
+
+#if __GNUC__ >= 11
+
+#pragma GCC target("avx512bf16")
+#define WORKLOAD_NAME "AVX512_BF16"
+#define BITS_PER_VECTOR		512
+#define BYTES_PER_VECTOR	(BITS_PER_VECTOR / 8)
+#define WORDS_PER_VECTOR        (BITS_PER_VECTOR / 16)
+#define DWORD_PER_VECTOR	(BITS_PER_VECTOR / 32)
+#define DOTPROD_FILL		rng_fill_bf16
+
+#pragma GCC optimize("unroll-loops")
+
+struct thread_data {
+	uint8_t *input_x;	/* bf16 */
+	int8_t *input_y;	/* bf16 */
+	int32_t *input_z;	/* fp32 */
+	int16_t *input_ones;
+	int32_t *output;	/* fp32 */
+	int data_entries;
+};
+
+static void work(void *arg)
+{
+	int i;
+	struct thread_data *dp = (struct thread_data *)arg;
+	int entries = dp->data_entries;
+
+	for (i = 0; i < entries; ++i) {
+		__m512bh vx, vy;
+		__m512 vz, voutput;
+
+		vx = (__m512bh)_mm512_loadu_si512((void *)(dp->input_x + i * BYTES_PER_VECTOR));
+		vy = (__m512bh)_mm512_loadu_si512((void *)(dp->input_y + i * BYTES_PER_VECTOR));
+		vz = _mm512_loadu_ps((void *)(dp->input_z + i * DWORD_PER_VECTOR));
+
+		voutput = _mm512_dpbf16_ps(vz, vx, vy);
+
+		_mm512_storeu_ps((void *)(dp->output + i * DWORD_PER_VECTOR), voutput);
+	}
+}
+
+/* two bf16 multiply-adds per float lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (unsigned long long)dp->data_entries * DWORD_PER_VECTOR * 2 * 2;
+}
+
+#include "worker_init_dotprod.c"
+#include "run_common.c"
+
+static struct workload w = {
+	"AVX512_BF16",
+	init,
+	cleanup,
+	run,
+	"FLOP",
+};
+
+struct workload *register_AVX512_BF16(void)
+{
+	if (cpuid.avx512_bf16)
+		return &w;
+
+	return NULL;
+}
+#else
+
+#warning GCC < 11 can not build work_AVX512_BF16.c
+
+#endif /* GCC < 11 */
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * offer the "AVX512_FP16" workload to yogini
+ *
+ * vfmadd231ph, 32 fp16 multiply-adds per instruction, on fp16 inputs
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>		/* printf(3) */
+#include <stdlib.h>
+#include "yogini.h"
+#include <immintrin.h>
+#include <stdint.h>
+#include <err.h>
+
+#if __GNUC__ >= 12
+
+#pragma GCC target("avx512fp16")
+#define WORKLOAD_NAME "AVX512_FP16"
+#define BITS_PER_VECTOR		512
+#define BYTES_PER_VECTOR	(BITS_PER_VECTOR / 8)
+#define WORDS_PER_VECTOR        (BITS_PER_VECTOR / 16)
+#define DWORD_PER_VECTOR	(BITS_PER_VECTOR / 32)
+#define DOTPROD_FILL		rng_fill_fp16
+
+#pragma GCC optimize("unroll-loops")
+
+struct thread_data {
+	uint8_t *input_x;	/* fp16 */
+	int8_t *input_y;	/* fp16 */
+	int32_t *input_z;	/* fp16 */
+	int16_t *input_ones;
+	int32_t *output;	/* fp16 */
+	int data_entries;
+};
+
+static void work(void *arg)
+{
+	int i;
+	struct thread_data *dp = (struct thread_data *)arg;
+	int entries = dp->data_entries;
+
+	for (i = 0; i < entries; ++i) {
+		__m512h vx, vy, vz, voutput;
+
+		vx = _mm512_loadu_ph((void *)(dp->input_x + i * BYTES_PER_VECTOR));
+		vy = _mm512_loadu_ph((void *)(dp->input_y + i * BYTES_PER_VECTOR));
+		vz = _mm512_loadu_ph((void *)(dp->input_z + i * DWORD_PER_VECTOR));
+
+		voutput = _mm512_fmadd_ph(vx, vy, vz);
+
+		_mm512_storeu_ph((void *)(dp->output + i * DWORD_PER_VECTOR), voutput);
+	}
+}
+
+/* one multiply-add per fp16 lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (unsigned long long)dp->data_entries * WORDS_PER_VECTOR * 2;
+}
+
+#include "worker_init_dotprod.c"
+#include "run_common.c"
+
+static struct workload w = {
+	"AVX512_FP16",
+	init,
+	cleanup,
+	run,
+	"FLOP",
+};
+
+struct workload *register_AVX512_FP16(void)
+{
+	if (cpuid.avx512_fp16)
+		return &w;
+
+	return NULL;
+}
+#else
+
+#warning GCC < 12 can not build work_AVX512_FP16.c
+
+#endif /* GCC < 12 */
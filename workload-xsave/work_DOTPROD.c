@@ -42,12 +42,6 @@ static void work(void *arg)
 	v_ones = _mm256_loadu_si256((void *)dp->input_ones);
 
 	for (i = 0; i < entries; ++i) {
-		if (clfulsh) {
-			clflush_range((void *)dp->input_x + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_y + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_z + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-		}
-
 		__m256i vx, vy, vz, voutput;
 		__m256i vtmp1, vtmp2;
 
@@ -62,6 +56,14 @@ static void work(void *arg)
 	}
 }
 
+/* four 8-bit multiply-adds per dword lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (unsigned long long)dp->data_entries * DWORD_PER_VECTOR * 4 * 2;
+}
+
 #include "worker_init_dotprod.c"
 #include "run_common.c"
 
@@ -70,9 +72,13 @@ static struct workload w = {
 	init,
 	cleanup,
 	run,
+	"ops",
 };
 
 struct workload *register_DOTPROD(void)
 {
-	return &w;
+	if (cpuid.avx2 && cpuid.fma)
+		return &w;
+
+	return NULL;
 }
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * work_FMA.c - offer the FP64_* and FP32_* peak-FLOPS workloads to yogini
+ *
+ * Each is FMA_CHAINS independent c = c * m + a chains in registers,
+ * with no loads or stores in the loop, so the only limit is FMA throughput.
+ * Two FMA ports with 4-cycle latency need 8 chains in flight; 12 leave
+ * room for 5- and 6-cycle FMAs. m < 1, so the chains converge to a / (1 - m)
+ * and never reach denormals or infinity.
+ *
+ * SSE has no FMA, so the *_SSE workloads are 128-bit VEX FMA,
+ * which still needs FMA3 in CPUID.
+ *
+ * Peak assumes two FMA units at every width; on parts with
+ * a single 512-bit FMA unit, the AVX512 workloads top out at 50%.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>		/* printf(3) */
+#include <stdlib.h>
+#include <err.h>
+#include <immintrin.h>
+#include "yogini.h"
+
+#define FMA_CHAINS	12
+#define FMA_LOOPS	4096
+#define FMA_PORTS	2
+#define FMA_MUL		0.999999
+#define FMA_ADD		1e-6
+
+enum { FP64_SSE, FP64_AVX2, FP64_AVX512, FP32_SSE, FP32_AVX2, FP32_AVX512, FMA_KERNELS };
+
+/* elements per vector of each kernel */
+static const int fma_lanes[FMA_KERNELS] = { 2, 4, 8, 4, 8, 16 };
+
+struct thread_data {
+	int kernel;
+	double seed[FMA_CHAINS];
+	/* every chain is stored here after each pass, so none is dead code */
+	double out[FMA_CHAINS * 8] __attribute__((aligned(64)));
+};
+
+/*
+ * FMA_KERNEL()
+ * FMA_LOOPS iterations of FMA_CHAINS dependent chains of fma(c, m, a)
+ */
+#define FMA_KERNEL(name, isa, vec, set1, fmadd, store, type)			\
+__attribute__((target(isa)))							\
+static void name(struct thread_data *dp)					\
+{										\
+	vec m = set1(FMA_MUL), a = set1(FMA_ADD);				\
+	vec c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11;			\
+	type *out = (type *)dp->out;						\
+	int i;									\
+										\
+	/* distinct starts, or the compiler folds the chains into one */	\
+	c0 = set1(dp->seed[0]);							\
+	c1 = set1(dp->seed[1]);							\
+	c2 = set1(dp->seed[2]);							\
+	c3 = set1(dp->seed[3]);							\
+	c4 = set1(dp->seed[4]);							\
+	c5 = set1(dp->seed[5]);							\
+	c6 = set1(dp->seed[6]);							\
+	c7 = set1(dp->seed[7]);							\
+	c8 = set1(dp->seed[8]);							\
+	c9 = set1(dp->seed[9]);							\
+	c10 = set1(dp->seed[10]);						\
+	c11 = set1(dp->seed[11]);						\
+										\
+	for (i = 0; i < FMA_LOOPS; i++) {					\
+		c0 = fmadd(c0, m, a);						\
+		c1 = fmadd(c1, m, a);						\
+		c2 = fmadd(c2, m, a);						\
+		c3 = fmadd(c3, m, a);						\
+		c4 = fmadd(c4, m, a);						\
+		c5 = fmadd(c5, m, a);						\
+		c6 = fmadd(c6, m, a);						\
+		c7 = fmadd(c7, m, a);						\
+		c8 = fmadd(c8, m, a);						\
+		c9 = fmadd(c9, m, a);						\
+		c10 = fmadd(c10, m, a);						\
+		c11 = fmadd(c11, m, a);						\
+	}									\
+										\
+	store(out + 0 * sizeof(vec) / sizeof(type), c0);			\
+	store(out + 1 * sizeof(vec) / sizeof(type), c1);			\
+	store(out + 2 * sizeof(vec) / sizeof(type), c2);			\
+	store(out + 3 * sizeof(vec) / sizeof(type), c3);			\
+	store(out + 4 * sizeof(vec) / sizeof(type), c4);			\
+	store(out + 5 * sizeof(vec) / sizeof(type), c5);			\
+	store(out + 6 * sizeof(vec) / sizeof(type), c6);			\
+	store(out + 7 * sizeof(vec) / sizeof(type), c7);			\
+	store(out + 8 * sizeof(vec) / sizeof(type), c8);			\
+	store(out + 9 * sizeof(vec) / sizeof(type), c9);			\
+	store(out + 10 * sizeof(vec) / sizeof(type), c10);			\
+	store(out + 11 * sizeof(vec) / sizeof(type), c11);			\
+}
+
+FMA_KERNEL(fma_fp64_sse, "fma", __m128d, _mm_set1_pd, _mm_fmadd_pd, _mm_store_pd, double)
+FMA_KERNEL(fma_fp64_avx2, "fma,avx2", __m256d, _mm256_set1_pd, _mm256_fmadd_pd, _mm256_store_pd, double)
+FMA_KERNEL(fma_fp64_avx512, "avx512f", __m512d, _mm512_set1_pd, _mm512_fmadd_pd, _mm512_store_pd, double)
+FMA_KERNEL(fma_fp32_sse, "fma", __m128, _mm_set1_ps, _mm_fmadd_ps, _mm_store_ps, float)
+FMA_KERNEL(fma_fp32_avx2, "fma,avx2", __m256, _mm256_set1_ps, _mm256_fmadd_ps, _mm256_store_ps, float)
+FMA_KERNEL(fma_fp32_avx512, "avx512f", __m512, _mm512_set1_ps, _mm512_fmadd_ps, _mm512_store_ps, float)
+
+static void (*fma_kernels[FMA_KERNELS])(struct thread_data *dp) = {
+	fma_fp64_sse, fma_fp64_avx2, fma_fp64_avx512,
+	fma_fp32_sse, fma_fp32_avx2, fma_fp32_avx512,
+};
+
+static void work(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	fma_kernels[dp->kernel](dp);
+}
+
+/* an FMA is two FLOP per lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return 2ULL * FMA_LOOPS * FMA_CHAINS * fma_lanes[dp->kernel];
+}
+
+static int init_fma(struct work_instance *wi, int kernel)
+{
+	struct thread_data *dp;
+	int i;
+
+	dp = (struct thread_data *)aligned_alloc(64, sizeof(struct thread_data));
+	if (!dp)
+		err(1, "thread_data");
+
+	dp->kernel = kernel;
+	/* any start in (0, 1) converges */
+	for (i = 0; i < FMA_CHAINS; i++)
+		dp->seed[i] = (rng_u32(RNG_KEY(wi, 0), i) >> 8) / 16777216.0;
+
+	wi->worker_data = dp;
+
+	return 0;
+}
+
+static int cleanup(struct work_instance *wi)
+{
+	free(wi->worker_data);
+	wi->worker_data = NULL;
+
+	return 0;
+}
+
+#include "run_common.c"
+
+/*
+ * FMA_WORKLOAD()
+ * the workload for kernel, with lanes elements per vector,
+ * offered only if supported
+ */
+#define FMA_WORKLOAD(kernel, lanes, supported)				\
+static int init_##kernel(struct work_instance *wi)			\
+{									\
+	return init_fma(wi, kernel);					\
+}									\
+									\
+static struct workload kernel##_workload = {				\
+	#kernel,							\
+	init_##kernel,							\
+	cleanup,							\
+	run,								\
+	"FLOP",								\
+	2.0 * FMA_PORTS * (lanes),					\
+};									\
+									\
+struct workload *register_##kernel(void)				\
+{									\
+	if (supported)							\
+		return &kernel##_workload;				\
+									\
+	return NULL;							\
+}
+
+FMA_WORKLOAD(FP64_SSE, 2, cpuid.fma)
+FMA_WORKLOAD(FP64_AVX2, 4, cpuid.fma && cpuid.avx2)
+FMA_WORKLOAD(FP64_AVX512, 8, cpuid.avx512f)
+FMA_WORKLOAD(FP32_SSE, 4, cpuid.fma)
+FMA_WORKLOAD(FP32_AVX2, 8, cpuid.fma && cpuid.avx2)
+FMA_WORKLOAD(FP32_AVX512, 16, cpuid.avx512f)
@@ -19,8 +19,12 @@
 #include "string.h"
 #include <err.h>
 #include <stdint.h>
+#include <immintrin.h>
 void thread_break(int32_t reason, uint32_t thread_idx);
 #define MEM_BYTES_PER_ITERATION (4 * 1024)
+#define PREFETCH_DISTANCE	1024
+
+typedef void *(*copy_fn)(void *dest, const void *src, size_t n);
 
 struct thread_data {
 	char *buf1;
@@ -46,13 +50,8 @@ static int init(struct work_instance *wi)
 		errx(-1, "MEM: working-set size minimum of %dKB.\n",
 		     (2 * MEM_BYTES_PER_ITERATION) / 1024);
 	}
-	dp->buf1 = malloc(wi->wi_bytes / 2);
-	dp->buf2 = malloc(wi->wi_bytes / 2);
-
-	if (!dp->buf1 || !dp->buf2) {
-		perror("malloc");
-		exit(-1);
-	}
+	dp->buf1 = alloc_work_buffer(wi, wi->wi_bytes / 2);
+	dp->buf2 = alloc_work_buffer(wi, wi->wi_bytes / 2);
 
 	wi->worker_data = dp;
 
@@ -63,8 +62,8 @@ static int cleanup(struct work_instance *wi)
 {
 	struct thread_data *dp = wi->worker_data;
 
-	free(dp->buf1);
-	free(dp->buf2);
+	free_work_buffer(wi, dp->buf1, wi->wi_bytes / 2);
+	free_work_buffer(wi, dp->buf2, wi->wi_bytes / 2);
 	free(dp);
 
 	wi->worker_data = NULL;
@@ -84,17 +83,143 @@ static void *linux_memcpy(void *dest, const void *src, size_t n)
 	return dest;
 }
 
+static void *movsb_memcpy(void *dest, const void *src, size_t n)
+{
+	void *ret = dest;
+
+	asm volatile ("rep movsb"
+		      : "+D" (dest), "+S"(src), "+c"(n)
+		      : : "memory");
+
+	return ret;
+}
+
+/*
+ * The vector copies below assume n is a multiple of 256 bytes
+ * and that dest is 64-byte aligned, true for MEM_BYTES_PER_ITERATION
+ * chunks of page-aligned buffers.
+ */
+__attribute__((target("avx2")))
+static void *avx2_memcpy(void *dest, const void *src, size_t n)
+{
+	__m256i *d = dest;
+	const __m256i *s = src;
+	size_t i;
+
+	for (i = 0; i < n / sizeof(__m256i); i += 4) {
+		__m256i v0 = _mm256_loadu_si256(s + i);
+		__m256i v1 = _mm256_loadu_si256(s + i + 1);
+		__m256i v2 = _mm256_loadu_si256(s + i + 2);
+		__m256i v3 = _mm256_loadu_si256(s + i + 3);
+
+		_mm256_store_si256(d + i, v0);
+		_mm256_store_si256(d + i + 1, v1);
+		_mm256_store_si256(d + i + 2, v2);
+		_mm256_store_si256(d + i + 3, v3);
+	}
+	return dest;
+}
+
+__attribute__((target("avx2")))
+static void *prefetch_memcpy(void *dest, const void *src, size_t n)
+{
+	__m256i *d = dest;
+	const __m256i *s = src;
+	size_t i;
+
+	for (i = 0; i < n / sizeof(__m256i); i += 4) {
+		_mm_prefetch((const char *)(s + i) + PREFETCH_DISTANCE, _MM_HINT_T0);
+		_mm_prefetch((const char *)(s + i) + PREFETCH_DISTANCE + 64, _MM_HINT_T0);
+
+		__m256i v0 = _mm256_loadu_si256(s + i);
+		__m256i v1 = _mm256_loadu_si256(s + i + 1);
+		__m256i v2 = _mm256_loadu_si256(s + i + 2);
+		__m256i v3 = _mm256_loadu_si256(s + i + 3);
+
+		_mm256_store_si256(d + i, v0);
+		_mm256_store_si256(d + i + 1, v1);
+		_mm256_store_si256(d + i + 2, v2);
+		_mm256_store_si256(d + i + 3, v3);
+	}
+	return dest;
+}
+
+__attribute__((target("avx512f")))
+static void *avx512_memcpy(void *dest, const void *src, size_t n)
+{
+	__m512i *d = dest;
+	const __m512i *s = src;
+	size_t i;
+
+	for (i = 0; i < n / sizeof(__m512i); i += 4) {
+		__m512i v0 = _mm512_loadu_si512(s + i);
+		__m512i v1 = _mm512_loadu_si512(s + i + 1);
+		__m512i v2 = _mm512_loadu_si512(s + i + 2);
+		__m512i v3 = _mm512_loadu_si512(s + i + 3);
+
+		_mm512_store_si512(d + i, v0);
+		_mm512_store_si512(d + i + 1, v1);
+		_mm512_store_si512(d + i + 2, v2);
+		_mm512_store_si512(d + i + 3, v3);
+	}
+	return dest;
+}
+
+/* movntdq, SSE2 is baseline on x86-64 */
+static void *nt_memcpy(void *dest, const void *src, size_t n)
+{
+	__m128i *d = dest;
+	const __m128i *s = src;
+	size_t i;
+
+	for (i = 0; i < n / sizeof(__m128i); i += 4) {
+		__m128i v0 = _mm_loadu_si128(s + i);
+		__m128i v1 = _mm_loadu_si128(s + i + 1);
+		__m128i v2 = _mm_loadu_si128(s + i + 2);
+		__m128i v3 = _mm_loadu_si128(s + i + 3);
+
+		_mm_stream_si128(d + i, v0);
+		_mm_stream_si128(d + i + 1, v1);
+		_mm_stream_si128(d + i + 2, v2);
+		_mm_stream_si128(d + i + 3, v3);
+	}
+	_mm_sfence();
+	return dest;
+}
+
+__attribute__((target("avx512f")))
+static void *nt512_memcpy(void *dest, const void *src, size_t n)
+{
+	__m512i *d = dest;
+	const __m512i *s = src;
+	size_t i;
+
+	for (i = 0; i < n / sizeof(__m512i); i += 4) {
+		__m512i v0 = _mm512_loadu_si512(s + i);
+		__m512i v1 = _mm512_loadu_si512(s + i + 1);
+		__m512i v2 = _mm512_loadu_si512(s + i + 2);
+		__m512i v3 = _mm512_loadu_si512(s + i + 3);
+
+		_mm512_stream_si512(d + i, v0);
+		_mm512_stream_si512(d + i + 1, v1);
+		_mm512_stream_si512(d + i + 2, v2);
+		_mm512_stream_si512(d + i + 3, v3);
+	}
+	_mm_sfence();
+	return dest;
+}
+
 /*
- * run()
+ * run_copy()
  * MEM bytes_to_copy, or until tsc_end
- * return bytes copied
+ * return the TSC at completion, bytes copied are in wi->work_done
  * use buf1 and buf2, in alternate directions
  */
-static unsigned long long run(struct work_instance *wi)
+static unsigned long long run_copy(struct work_instance *wi, copy_fn copy)
 {
 	char *src, *dst;
 	unsigned long long bytes_done;
-	unsigned long long bytes_to_copy = wi->repeat * MEM_BYTES_PER_ITERATION;
+	unsigned long long bytes_to_copy = (unsigned long long)wi->repeat * MEM_BYTES_PER_ITERATION;
 	struct thread_data *dp = wi->worker_data;
 
 	src = dp->buf1;
@@ -104,26 +229,156 @@ static unsigned long long run(struct work_instance *wi)
 		int kb;
 
 		for (kb = 0; kb < wi->wi_bytes / 1024 / 2; kb += 4) {
-			linux_memcpy(dst + kb * 1024, src + kb * 1024, MEM_BYTES_PER_ITERATION);
+			copy(dst + kb * 1024, src + kb * 1024, MEM_BYTES_PER_ITERATION);
 
 			bytes_done += MEM_BYTES_PER_ITERATION;
+			trace_record(wi);
 
 			thread_break(wi->break_reason, wi->thread_number);
 			if (bytes_to_copy && bytes_done >= bytes_to_copy)
 				goto done;
+			if (wi->tsc_end && rdtsc() >= wi->tsc_end)
+				goto done;
 		}
 	}
 done:
+	wi->work_done = bytes_done;
 	return rdtsc();
 }
 
+static unsigned long long run(struct work_instance *wi)
+{
+	return run_copy(wi, linux_memcpy);
+}
+
+static unsigned long long run_movsb(struct work_instance *wi)
+{
+	return run_copy(wi, movsb_memcpy);
+}
+
+static unsigned long long run_avx2(struct work_instance *wi)
+{
+	return run_copy(wi, avx2_memcpy);
+}
+
+static unsigned long long run_prefetch(struct work_instance *wi)
+{
+	return run_copy(wi, prefetch_memcpy);
+}
+
+static unsigned long long run_avx512(struct work_instance *wi)
+{
+	return run_copy(wi, avx512_memcpy);
+}
+
+static unsigned long long run_nt(struct work_instance *wi)
+{
+	return run_copy(wi, nt_memcpy);
+}
+
+static unsigned long long run_nt512(struct work_instance *wi)
+{
+	return run_copy(wi, nt512_memcpy);
+}
+
 static struct workload MEM_workload = {
 	"MEM",
 	init,
 	cleanup,
 	run,
+	"bytes",
+};
+
+static struct workload MEM_MOVSB_workload = {
+	"MEM_MOVSB",
+	init,
+	cleanup,
+	run_movsb,
+	"bytes",
+};
+
+static struct workload MEM_AVX2_workload = {
+	"MEM_AVX2",
+	init,
+	cleanup,
+	run_avx2,
+	"bytes",
+};
+
+static struct workload MEM_PREFETCH_workload = {
+	"MEM_PREFETCH",
+	init,
+	cleanup,
+	run_prefetch,
+	"bytes",
+};
+
+static struct workload MEM_AVX512_workload = {
+	"MEM_AVX512",
+	init,
+	cleanup,
+	run_avx512,
+	"bytes",
+};
+
+static struct workload MEM_NT_workload = {
+	"MEM_NT",
+	init,
+	cleanup,
+	run_nt,
+	"bytes",
+};
+
+static struct workload MEM_NT512_workload = {
+	"MEM_NT512",
+	init,
+	cleanup,
+	run_nt512,
+	"bytes",
 };
 
+struct workload *register_MEM_MOVSB(void)
+{
+	return &MEM_MOVSB_workload;
+}
+
+struct workload *register_MEM_AVX2(void)
+{
+	if (cpuid.avx2)
+		return &MEM_AVX2_workload;
+
+	return NULL;
+}
+
+struct workload *register_MEM_PREFETCH(void)
+{
+	if (cpuid.avx2)
+		return &MEM_PREFETCH_workload;
+
+	return NULL;
+}
+
+struct workload *register_MEM_AVX512(void)
+{
+	if (cpuid.avx512f)
+		return &MEM_AVX512_workload;
+
+	return NULL;
+}
+
+struct workload *register_MEM_NT(void)
+{
+	return &MEM_NT_workload;
+}
+
+struct workload *register_MEM_NT512(void)
+{
+	if (cpuid.avx512f)
+		return &MEM_NT512_workload;
+
+	return NULL;
+}
+
 struct workload *register_MEM(void)
 {
 	return &MEM_workload;
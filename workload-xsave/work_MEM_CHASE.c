@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * offer the "MEM_CHASE" workload to yogini
+ *
+ * A dependent pointer chase through a random cyclic permutation
+ * of the cache lines in the working set, so every load waits for the
+ * previous one and the hardware prefetchers have nothing to follow.
+ * ns per load is the load-to-use latency of wherever the working set lives.
+ *
+ * Copyright (c) 2024 Intel Corporation.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>		/* printf(3) */
+#include <stdlib.h>
+#include <err.h>
+#include <stdint.h>
+#include "yogini.h"
+
+void thread_break(int32_t reason, uint32_t thread_idx);
+#define CHASE_LINE_BYTES		64
+#define CHASE_LOADS_PER_ITERATION	1024
+
+struct thread_data {
+	char *buf;
+	void **head;
+};
+
+static int init(struct work_instance *wi)
+{
+	struct thread_data *dp;
+	unsigned int lines, i;
+	unsigned int *order;
+
+	dp = (struct thread_data *)calloc(1, sizeof(struct thread_data));
+	if (!dp)
+		err(1, "thread_data");
+
+	lines = wi->wi_bytes / CHASE_LINE_BYTES;
+	if (lines < 2)
+		errx(-1, "MEM_CHASE: working-set size minimum of %d bytes.\n",
+		     2 * CHASE_LINE_BYTES);
+
+	order = malloc(sizeof(unsigned int) * lines);
+	if (!order)
+		err(1, "MEM_CHASE order");
+
+	/* Sattolo's shuffle, a single cycle through every line */
+	for (i = 0; i < lines; i++)
+		order[i] = i;
+	for (i = lines - 1; i > 0; i--) {
+		unsigned int j = rng_u32(RNG_KEY(wi, 0), i) % i;
+		unsigned int tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	dp->buf = alloc_work_buffer(wi, wi->wi_bytes);
+	for (i = 0; i < lines; i++)
+		*(void **)(dp->buf + (size_t)i * CHASE_LINE_BYTES) =
+			dp->buf + (size_t)order[i] * CHASE_LINE_BYTES;
+	dp->head = (void **)dp->buf;
+
+	free(order);
+	wi->worker_data = dp;
+
+	return 0;
+}
+
+static int cleanup(struct work_instance *wi)
+{
+	struct thread_data *dp = wi->worker_data;
+
+	free_work_buffer(wi, dp->buf, wi->wi_bytes);
+	free(dp);
+
+	wi->worker_data = NULL;
+
+	return 0;
+}
+
+/*
+ * run()
+ * CHASE_LOADS_PER_ITERATION dependent loads per repeat, or until tsc_end
+ * return the TSC at completion, loads completed are in wi->work_done
+ */
+static unsigned long long run(struct work_instance *wi)
+{
+	struct thread_data *dp = wi->worker_data;
+	unsigned long long loads = 0;
+	void **p = dp->head;
+	unsigned int count;
+	int i;
+
+	for (count = 0; !wi->repeat || count < wi->repeat; count++) {
+		thread_break(wi->break_reason, wi->thread_number);
+
+		for (i = 0; i < CHASE_LOADS_PER_ITERATION; i += 8) {
+			p = *p; p = *p; p = *p; p = *p;
+			p = *p; p = *p; p = *p; p = *p;
+		}
+		loads += CHASE_LOADS_PER_ITERATION;
+		trace_record(wi);
+
+		if (wi->tsc_end && rdtsc() >= wi->tsc_end)
+			break;
+	}
+
+	/* keep the chase live, and resume from here next time */
+	dp->head = p;
+	wi->work_done = loads;
+	return rdtsc();
+}
+
+static struct workload MEM_CHASE_workload = {
+	"MEM_CHASE",
+	init,
+	cleanup,
+	run,
+	"loads",
+};
+
+struct workload *register_MEM_CHASE(void)
+{
+	return &MEM_CHASE_workload;
+}
@@ -24,6 +24,11 @@ static void work(void *arg)
 		asm volatile ("pause");
 }
 
+static unsigned long long work_size(void *arg)
+{
+	return DATA_ENTRIES;
+}
+
 #include "run_common.c"
 
 static struct workload w = {
@@ -31,6 +36,7 @@ static struct workload w = {
 	NULL,
 	NULL,
 	run,
+	"ops",
 };
 
 struct workload *register_PAUSE(void)
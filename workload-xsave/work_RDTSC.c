@@ -22,6 +22,11 @@ static inline void work(void *arg)
 
 #define DATA_ENTRIES 1
 
+static unsigned long long work_size(void *arg)
+{
+	return DATA_ENTRIES;
+}
+
 #include "run_common.c"
 
 static struct workload w = {
@@ -29,6 +34,7 @@ static struct workload w = {
 	NULL,
 	NULL,
 	run,
+	"ops",
 };
 
 struct workload *register_RDTSC(void)
@@ -36,10 +36,6 @@ static void work(void *arg)
 	int entries = dp->data_entries / sizeof(double);
 
 	for (i = 0; i < entries; ++i) {
-		if (clfulsh) {
-			clflush_range((void *)dp->input_x + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_y + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-		}
 		__m128i vx, vy, voutput;
 
 		vx = _mm_loadu_si128((__m128i *)dp->input_x);
@@ -50,6 +46,14 @@ static void work(void *arg)
 	}
 }
 
+/* one add per dword lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (dp->data_entries / sizeof(double)) * DWORD_PER_VECTOR;
+}
+
 #include "run_common.c"
 #include "worker_init_sse.c"
 
@@ -58,9 +62,13 @@ static struct workload w = {
 	init,
 	cleanup,
 	run,
+	"ops",
 };
 
 struct workload *register_SSE(void)
 {
-	return &w;
+	if (cpuid.sse4_2)
+		return &w;
+
+	return NULL;
 }
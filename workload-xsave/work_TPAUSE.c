@@ -35,6 +35,11 @@ static void work(void *arg)
 	_tpause(ctrl, tsc);
 }
 
+static unsigned long long work_size(void *arg)
+{
+	return DATA_ENTRIES;
+}
+
 #include "run_common.c"
 
 static struct workload w = {
@@ -42,6 +47,7 @@ static struct workload w = {
 	NULL,
 	NULL,
 	run,
+	"ops",
 };
 
 struct workload *register_TPAUSE(void)
@@ -30,6 +30,11 @@ static void work(void *arg)
 	_umwait(0, (unsigned long long)-1);
 }
 
+static unsigned long long work_size(void *arg)
+{
+	return DATA_ENTRIES;
+}
+
 #include "run_common.c"
 
 static struct workload w = {
@@ -37,6 +42,7 @@ static struct workload w = {
 	NULL,
 	NULL,
 	run,
+	"ops",
 };
 
 struct workload *register_UMWAIT(void)
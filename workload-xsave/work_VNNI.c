@@ -24,6 +24,7 @@
 #define BYTES_PER_VECTOR	(BITS_PER_VECTOR / 8)
 #define WORDS_PER_VECTOR        (BITS_PER_VECTOR / 16)
 #define DWORD_PER_VECTOR	(BITS_PER_VECTOR / 32)
+#define DOTPROD_PASS(entries)	((entries) / sizeof(double))
 
 #pragma GCC optimize("unroll-loops")
 
@@ -43,11 +44,6 @@ static void work(void *arg)
 	int entries = dp->data_entries / sizeof(double);
 
 	for (i = 0; i < entries; ++i) {
-		if (clfulsh) {
-			clflush_range((void *)dp->input_x + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_y + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_z + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-		}
 		__m256i vx, vy, vz, voutput;
 
 		vx = _mm256_loadu_si256((void *)(dp->input_x + i * BYTES_PER_VECTOR));
@@ -60,6 +56,14 @@ static void work(void *arg)
 	}
 }
 
+/* four 8-bit multiply-adds per dword lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (dp->data_entries / sizeof(double)) * DWORD_PER_VECTOR * 4 * 2;
+}
+
 #include "worker_init_dotprod.c"
 #include "run_common.c"
 
@@ -68,6 +72,7 @@ static struct workload w = {
 	init,
 	cleanup,
 	run,
+	"ops",
 };
 
 struct workload *register_VNNI(void)
@@ -40,11 +40,6 @@ static void work(void *arg)
 	int entries = dp->data_entries;
 
 	for (i = 0; i < entries; ++i) {
-		if (clfulsh) {
-			clflush_range((void *)dp->input_x + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_y + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-			clflush_range((void *)dp->input_z + i * BYTES_PER_VECTOR, BYTES_PER_VECTOR);
-		}
 		__m512i vx, vy, vz, voutput;
 
 		vx = _mm512_loadu_si512((void *)(dp->input_x + i * BYTES_PER_VECTOR));
@@ -57,6 +52,14 @@ static void work(void *arg)
 	}
 }
 
+/* four 8-bit multiply-adds per dword lane */
+static unsigned long long work_size(void *arg)
+{
+	struct thread_data *dp = (struct thread_data *)arg;
+
+	return (unsigned long long)dp->data_entries * DWORD_PER_VECTOR * 4 * 2;
+}
+
 #include "worker_init_dotprod.c"
 #include "run_common.c"
 
@@ -65,6 +68,7 @@ static struct workload w = {
 	init,
 	cleanup,
 	run,
+	"ops",
 };
 
 struct workload *register_VNNI512(void)
@@ -50,13 +50,8 @@ static int init(struct work_instance *wi)
 		     (2 * MEM_BYTES_PER_ITERATION) / 1024);
 	}
 
-	dp->buf1 = malloc(wi->wi_bytes / 2);
-	dp->buf2 = malloc(wi->wi_bytes / 2);
-
-	if (!dp->buf1 || !dp->buf2) {
-		perror("malloc");
-		exit(-1);
-	}
+	dp->buf1 = alloc_work_buffer(wi, wi->wi_bytes / 2);
+	dp->buf2 = alloc_work_buffer(wi, wi->wi_bytes / 2);
 
 	wi->worker_data = dp;
 
@@ -67,8 +62,8 @@ static int cleanup(struct work_instance *wi)
 {
 	struct thread_data *dp = wi->worker_data;
 
-	free(dp->buf1);
-	free(dp->buf2);
+	free_work_buffer(wi, dp->buf1, wi->wi_bytes / 2);
+	free_work_buffer(wi, dp->buf2, wi->wi_bytes / 2);
 	free(dp);
 
 	wi->worker_data = NULL;
@@ -79,14 +74,14 @@ static int cleanup(struct work_instance *wi)
 /*
  * run()
  * MEM bytes_to_copy, or until tsc_end
- * return bytes copied
+ * return the TSC at completion, bytes copied are in wi->work_done
  * use buf1 and buf2, in alternate directions
  */
 static unsigned long long run(struct work_instance *wi)
 {
 	char *src, *dst;
 	unsigned long long bytes_done;
-	unsigned long long bytes_to_copy = wi->repeat * MEM_BYTES_PER_ITERATION;
+	unsigned long long bytes_to_copy = (unsigned long long)wi->repeat * MEM_BYTES_PER_ITERATION;
 	struct thread_data *dp = wi->worker_data;
 
 	src = dp->buf1;
@@ -100,13 +95,17 @@ static unsigned long long run(struct work_instance *wi)
 			memcpy(dst + kb * 1024, src + kb * 1024, MEM_BYTES_PER_ITERATION);
 
 			bytes_done += MEM_BYTES_PER_ITERATION;
+			trace_record(wi);
 
 			thread_break(wi->break_reason, wi->thread_number);
 			if (bytes_to_copy && bytes_done >= bytes_to_copy)
 				goto done;
+			if (wi->tsc_end && rdtsc() >= wi->tsc_end)
+				goto done;
 		}
 	}
 done:
+	wi->work_done = bytes_done;
 	return rdtsc();
 }
 
@@ -115,6 +114,7 @@ static struct workload memcpy_workload = {
 	init,
 	cleanup,
 	run,
+	"bytes",
 };
 
 struct workload *register_memcpy(void)
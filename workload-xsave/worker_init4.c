@@ -9,20 +9,25 @@
 #include <err.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include "yogini.h"
 
-static double get_random_double(void)
+/* random 64-bit integers, as doubles */
+static void init_random_doubles(double *p, int entries, uint32_t key)
 {
-	unsigned long long random_int64;
+	int i;
 
-	random_int64 = (long long)random() | (((long long)random()) << 32);
+	rng_fill(p, entries * sizeof(double), key);
+	for (i = 0; i < entries; ++i) {
+		unsigned long long random_int64;
 
-	return (double)random_int64;
+		memcpy(&random_int64, &p[i], sizeof(random_int64));
+		p[i] = (double)random_int64;
+	}
 }
 
 static int init(struct work_instance *wi)
 {
-	int i;
 	struct thread_data *dp;
 	int bytes_per_entry = sizeof(double) * 4;	/* a[], x[], y[], z[] */
 	int entries;
@@ -33,8 +38,6 @@ static int init(struct work_instance *wi)
 	if (!dp)
 		err(1, "thread_data");
 
-	srand((int)time(0));
-
 	dp->a = malloc(entries * sizeof(double));
 	dp->x = malloc(entries * sizeof(double));
 	dp->y = malloc(entries * sizeof(double));
@@ -44,12 +47,10 @@ static int init(struct work_instance *wi)
 	if (!dp->a || !dp->x || !dp->y || !dp->z)
 		errx(-1, "malloc failed");
 
-	for (i = 0; i < entries; ++i) {
-		dp->a[i] = get_random_double();
-		dp->x[i] = get_random_double();
-		dp->y[i] = get_random_double();
-		dp->z[i] = get_random_double();
-	}
+	init_random_doubles(dp->a, entries, RNG_KEY(wi, 0));
+	init_random_doubles(dp->x, entries, RNG_KEY(wi, 1));
+	init_random_doubles(dp->y, entries, RNG_KEY(wi, 2));
+	init_random_doubles(dp->z, entries, RNG_KEY(wi, 3));
 	wi->worker_data = dp;
 
 	return 0;
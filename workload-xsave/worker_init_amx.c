@@ -11,18 +11,6 @@
 #define YOGINI_MAIN
 #include "yogini.h"
 
-static void init_dword_tile(int8_t *ptr, uint8_t rows, uint8_t colsb, int entries)
-{
-	int32_t i, j, k;
-	int32_t cols = colsb / 4;
-
-	for (k = 0; k < entries; ++k) {
-		for (i = 0; i < rows; i++)
-			for (j = 0; j < cols; j++)
-				ptr[k * rows * cols + i * cols + j] = random();
-	}
-}
-
 static int init(struct work_instance *wi)
 {
 	struct thread_data *dp;
@@ -40,17 +28,9 @@ static int init(struct work_instance *wi)
 	if (!dp)
 		err(1, "thread_data");
 
-	dp->input_x = (int8_t *)calloc(entries, BYTES_PER_VECTOR);
-	if (!dp->input_x)
-		err(1, "calloc input_x");
-
-	dp->input_y = (int8_t *)calloc(entries, BYTES_PER_VECTOR);
-	if (!dp->input_y)
-		err(1, "calloc input_y");
-
-	/* initialize input -- make every iteration the same for now */
-	init_dword_tile(dp->input_x, ROW_NUM, COL_NUM, entries);
-	init_dword_tile(dp->input_y, ROW_NUM, COL_NUM, entries);
+	/* read-only, may be shared with other workers, see -i */
+	dp->input_x = get_input_buffer(wi, 0, (size_t)entries * BYTES_PER_VECTOR, rng_fill);
+	dp->input_y = get_input_buffer(wi, 1, (size_t)entries * BYTES_PER_VECTOR, rng_fill);
 
 	dp->output = (int32_t *) calloc(entries, BYTES_PER_VECTOR);
 	if (dp->output == NULL)
@@ -58,6 +38,11 @@ static int init(struct work_instance *wi)
 
 	dp->data_entries = entries;
 
+	/* the working set, for -C */
+	cache_state_add(wi, dp->input_x, (size_t)entries * BYTES_PER_VECTOR);
+	cache_state_add(wi, dp->input_y, (size_t)entries * BYTES_PER_VECTOR);
+	cache_state_add(wi, dp->output, (size_t)entries * BYTES_PER_VECTOR);
+
 	wi->worker_data = dp;
 
 	return 0;
@@ -67,8 +52,8 @@ static int cleanup(struct work_instance *wi)
 {
 	struct thread_data *dp = wi->worker_data;
 
-	free(dp->input_x);
-	free(dp->input_y);
+	put_input_buffer(wi, dp->input_x);
+	put_input_buffer(wi, dp->input_y);
 	free(dp->output);
 	free(dp);
 	wi->worker_data = NULL;
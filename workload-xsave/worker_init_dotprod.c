@@ -4,6 +4,17 @@
  * Len Brown <len.brown@intel.com>
  */
 #include <stdint.h>
+
+/* workloads on float inputs define their own input_fill_fn, e.g. rng_fill_fp32 */
+#ifndef DOTPROD_FILL
+#define DOTPROD_FILL	rng_fill
+#endif
+
+/* and those whose work() covers fewer vectors define how many */
+#ifndef DOTPROD_PASS
+#define DOTPROD_PASS(entries)	(entries)
+#endif
+
 static int init(struct work_instance *wi)
 {
 	int i;
@@ -17,38 +28,15 @@ static int init(struct work_instance *wi)
 	if (!dp)
 		err(1, "thread_data");
 
-	dp->input_x = (uint8_t *)calloc(entries, BYTES_PER_VECTOR);
-	if (!dp->input_x)
-		err(1, "calloc input_x");
-
-	dp->input_y = (int8_t *)calloc(entries, BYTES_PER_VECTOR);
-	if (!dp->input_y)
-		err(1, "calloc input_y");
-
-	dp->input_z = (int32_t *)calloc(entries, BYTES_PER_VECTOR);
-	if (!dp->input_z)
-		err(1, "calloc input_z");
+	/* read-only, may be shared with other workers, see -i */
+	dp->input_x = get_input_buffer(wi, 0, (size_t)entries * BYTES_PER_VECTOR, DOTPROD_FILL);
+	dp->input_y = get_input_buffer(wi, 1, (size_t)entries * BYTES_PER_VECTOR, DOTPROD_FILL);
+	dp->input_z = get_input_buffer(wi, 2, (size_t)entries * BYTES_PER_VECTOR, DOTPROD_FILL);
 
 	dp->input_ones = (int16_t *)calloc(1, BYTES_PER_VECTOR);
 	if (!dp->input_ones)
 		err(1, "calloc input_ones");
 
-	/* initialize input -- make every iteration the same for now */
-	for (i = 0; i < entries; ++i) {
-		int j;
-
-		for (j = 0; j < BYTES_PER_VECTOR; j++) {
-			int index = i * BYTES_PER_VECTOR + j;
-
-			dp->input_x[index] = j;
-			dp->input_y[index] = BYTES_PER_VECTOR + j;
-		}
-		for (j = 0; j < DWORD_PER_VECTOR; j++) {
-			int index = i * DWORD_PER_VECTOR + j;
-
-			dp->input_z[index] = j;
-		}
-	}
 	for (i = 0; i < WORDS_PER_VECTOR; i++)
 		dp->input_ones[i] = 1;
 
@@ -57,6 +45,12 @@ static int init(struct work_instance *wi)
 		err(1, "calloc output");
 	dp->data_entries = entries;
 
+	/* the working set, for -C, as far as work() goes */
+	cache_state_add(wi, dp->input_x, (size_t)DOTPROD_PASS(entries) * BYTES_PER_VECTOR);
+	cache_state_add(wi, dp->input_y, (size_t)DOTPROD_PASS(entries) * BYTES_PER_VECTOR);
+	cache_state_add(wi, dp->input_z, (size_t)DOTPROD_PASS(entries) * BYTES_PER_VECTOR);
+	cache_state_add(wi, dp->output, (size_t)DOTPROD_PASS(entries) * BYTES_PER_VECTOR);
+
 	wi->worker_data = dp;
 
 	return 0;
@@ -66,9 +60,9 @@ static int cleanup(struct work_instance *wi)
 {
 	struct thread_data *dp = wi->worker_data;
 
-	free(dp->input_x);
-	free(dp->input_y);
-	free(dp->input_z);
+	put_input_buffer(wi, dp->input_x);
+	put_input_buffer(wi, dp->input_y);
+	put_input_buffer(wi, dp->input_z);
 	free(dp->input_ones);
 	free(dp->output);
 	free(dp);
@@ -42,6 +42,11 @@ static int init(struct work_instance *wi)
 		err(1, "calloc output");
 	dp->data_entries = entries;
 
+	/* the working set, for -C: work() touches entries / sizeof(double) vectors */
+	cache_state_add(wi, dp->input_x, entries / sizeof(double) * BYTES_PER_VECTOR);
+	cache_state_add(wi, dp->input_y, entries / sizeof(double) * BYTES_PER_VECTOR);
+	cache_state_add(wi, dp->output, entries / sizeof(double) * BYTES_PER_VECTOR);
+
 	wi->worker_data = dp;
 
 	return 0;
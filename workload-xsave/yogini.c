@@ -14,11 +14,16 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
 #include <time.h>
 #include <cpuid.h>
 #include <math.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/membarrier.h>
 #include <linux/futex.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -27,19 +32,13 @@
 #define YOGINI_MAIN
 #include "yogini.h"
 
-enum {
-	BREAK_BY_NOTHING = 0,
-	BREAK_BY_YIELD = 1,
-	BREAK_BY_SLEEP,
-	BREAK_BY_TRAP,
-	BREAK_BY_SIGNAL,
-	BREAK_BY_FUTEX,
-	BREAK_REASON_MAX = BREAK_BY_FUTEX
-} BREAK_REASON;
 #define FUTEX_VAL 0x5E5E5E5E
 
 int repeat_cnt;
-int clfulsh;
+double duration_sec;
+static int sweep;
+static int oversub;	/* -O threads per CPU, 0 for one thread per -w */
+static int pair;	/* -p SMT sibling interference matrix */
 char *progname;
 struct workload *all_workloads;
 struct work_instance *first_worker;
@@ -47,17 +46,69 @@ struct work_instance *last_worker;
 
 static int num_worker_threads;
 static int num_checked_in_threads;
-static pthread_mutex_t checkin_mutex;
-static pthread_cond_t checkin_cv = PTHREAD_COND_INITIALIZER;
+static int barrier_sense;
+static __thread int local_sense;
+static unsigned long long go_tsc;
 int32_t break_reason = BREAK_BY_NOTHING;
+int release_mode = RELEASE_HOLD;
+char *release_mode_names[] = {
+	[RELEASE_HOLD] = "hold",
+	[RELEASE_ALWAYS] = "release",
+	[RELEASE_TOGGLE] = "toggle",
+};
+char *break_reason_names[] = {
+	[BREAK_BY_NOTHING] = "none",
+	[BREAK_BY_YIELD] = "yield",
+	[BREAK_BY_SLEEP] = "sleep",
+	[BREAK_BY_TRAP] = "trap",
+	[BREAK_BY_SIGNAL] = "signal",
+	[BREAK_BY_FUTEX] = "futex",
+	[BREAK_BY_FUTEX_GEN] = "futex_gen",
+	[BREAK_BY_MIGRATE] = "migrate",
+	[BREAK_BY_FAULT] = "fault",
+	[BREAK_BY_MPROTECT] = "mprotect",
+	[BREAK_BY_MEMBARRIER] = "membarrier",
+};
 static int32_t *futex_ptr;
+/* BREAK_BY_FUTEX_GEN: bumped, then all waiters woken, break_hz times a second */
+static uint32_t futex_gen;
+/* TSC of each recent bump, by generation, see futex_gen_tsc() */
+#define FUTEX_GEN_SLOTS	256
+static unsigned long long futex_wake_tsc[FUTEX_GEN_SLOTS];
+unsigned int break_hz = BREAK_HZ_DEFAULT;
+static __thread timer_t signal_timer;
+static __thread unsigned long long signal_next_ns;	/* expiry the next SIGUSR1 is for */
+static __thread unsigned long long signal_overruns;
+static __thread struct histogram *break_hist;
+static __thread unsigned long long break_xinuse;
+static __thread struct histogram *release_hist;
+/* BREAK_BY_MIGRATE: the CPUs a worker may run on, and its two pinned masks */
+static cpu_set_t migrate_allowed;
+static __thread cpu_set_t migrate_mask[2];
+static __thread int migrate_next;
+/* BREAK_BY_FAULT and BREAK_BY_MPROTECT: a private page to fault or protect */
+static __thread volatile char *break_page;
+static __thread unsigned long long release_xinuse;
+static __thread unsigned int break_count;
 static bool *thread_done;
 pthread_t *tid_ptr;
 
 unsigned int SIZE_1GB = 1024 * 1024 * 1024;
+unsigned long long tsc_per_sec;
+static char *tsc_source = "cpuid";
 
 struct cpuid cpuid;
 
+/*
+ * Components xstate_reset() may put back in init state: SSE, AVX,
+ * AVX-512 and AMX tile data. x87, PKRU and TILECFG hold configuration
+ * (control word, protection keys, tile palette), so they are left alone.
+ */
+#define XFEATURE_MASK_RESETTABLE	((1ULL << 1) | (1ULL << 2) | (1ULL << 5) | \
+					 (1ULL << 6) | (1ULL << 7) | (1ULL << 18))
+#define MXCSR_DEFAULT			0x1f80
+static uint8_t *xstate_init_image;
+
 static void dump_command(int argc, char **argv)
 {
 	int i;
@@ -89,26 +140,119 @@ static void help(void)
 	dump_workloads();
 	fprintf(stderr,
 		"  -r, --repeat, each instance needs to be run\n"
-		"  -b, --break_reason, [yield/sleep/trap/signal/futex]\n"
+		"  -t, --duration, seconds each instance runs, whichever of -r/-t ends first\n"
+		"  -b, --break_reason, [yield/sleep/trap/signal/futex/futex_gen/\n"
+		"      migrate/fault/mprotect/membarrier]\n"
+		"  -R, --rate, HZ SIGUSR1s per second to each worker for -b signal,\n"
+		"      or wakeups of all workers for -b futex_gen, default 1000, max 1000000\n"
+		"  -c, --cpus, [cpulist/compact/scatter/core/smt] bind workers to CPUs\n"
+		"  -o, --format, [text/json/csv] result format, default text\n"
+		"  -a, --alloc, [workload=]page[,local/interleave][,populate] buffer policy,\n"
+		"      page is default/4k/thp/2m/1g, used by the MEM copies, MEM_CHASE, memcpy\n"
+		"  -s, --sweep, rerun at working-set sizes from L1d/2 to 4x LLC\n"
+		"  -O, --oversub, N threads of the -w mix on every -c CPU, after\n"
+		"      each workload alone, to estimate the cost per context switch\n"
+		"  -p, --pair, run every pair of the -w workloads, or of all of them,\n"
+		"      on the two SMT siblings of a core, and each one alone\n"
+		"  -i, --inputs, [private/shared/node] input buffers per worker,\n"
+		"      per workload, or per workload per NUMA node\n"
+		"  -C, --cache, [hot/llc/cold] cache state of the working set before\n"
+		"      each pass, set up outside the timed region, -f is -C cold\n"
+		"  -T, --trace, FILE per-iteration TSC trace of every worker,\n"
+		"      written as CSV, or binary if FILE ends in .bin\n"
+		"  -Z, --release, [hold/release/toggle] TILERELEASE and VZEROUPPER before\n"
+		"      no, every, or every other break, to compare their cost\n"
+		"  -X, --fpu_events, [count/FILE] count the x86_fpu tracepoints of every\n"
+		"      worker, per xfeatures mask, and write the samples to FILE\n"
 		"For more help, see README\n");
 	exit(0);
 }
 
 int parse_break_cmd(char *input_string)
 {
-	if (strcmp(input_string, "sleep") == 0)
-		break_reason = BREAK_BY_SLEEP;
-	else if (strcmp(input_string, "yield") == 0)
-		break_reason = BREAK_BY_YIELD;
-	else if (strcmp(input_string, "trap") == 0)
-		break_reason = BREAK_BY_TRAP;
-	else if (strcmp(input_string, "signal") == 0)
-		break_reason = BREAK_BY_SIGNAL;
-	else if (strcmp(input_string, "futex") == 0)
-		break_reason = BREAK_BY_FUTEX;
-	else
-		return -1;
-	return 0;
+	int i;
+
+	/* start_test.sh passes the numeric break reason */
+	if (isdigit((unsigned char)input_string[0])) {
+		i = atoi(input_string);
+		if (i < BREAK_BY_YIELD || i > BREAK_REASON_MAX)
+			return -1;
+		break_reason = i;
+		return 0;
+	}
+
+	for (i = BREAK_BY_YIELD; i <= BREAK_REASON_MAX; i++) {
+		if (strcmp(input_string, break_reason_names[i]) == 0) {
+			break_reason = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int parse_release_cmd(char *input_string)
+{
+	int i;
+
+	for (i = RELEASE_HOLD; i <= RELEASE_MAX; i++) {
+		if (strcmp(input_string, release_mode_names[i]) == 0) {
+			release_mode = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*
+ * measure_tsc_per_sec()
+ * used when CPUID does not enumerate the TSC frequency, e.g. in a guest
+ */
+static unsigned long long measure_tsc_per_sec(void)
+{
+	struct timespec ts_bgn, ts_end;
+	struct timespec req = { 0, 100 * 1000 * 1000 };
+	unsigned long long tsc_bgn, tsc_end, ns;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts_bgn);
+	tsc_bgn = rdtsc();
+	nanosleep(&req, NULL);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts_end);
+	tsc_end = rdtsc();
+
+	ns = (ts_end.tv_sec - ts_bgn.tv_sec) * 1000000000ULL + ts_end.tv_nsec - ts_bgn.tv_nsec;
+
+	return (tsc_end - tsc_bgn) * 1000000000ULL / ns;
+}
+
+#define XCR0_AVX	((1 << 1) | (1 << 2))			/* SSE, YMM */
+#define XCR0_AVX512	(XCR0_AVX | (7 << 5))			/* opmask, ZMM_Hi256, Hi16_ZMM */
+#define XCR0_AMX	((1 << 17) | (1 << 18))			/* XTILECFG, XTILEDATA */
+
+/*
+ * os_xsave_features()
+ * CPUID says what the CPU can do, XCR0 says which register state the
+ * kernel saves: drop the vector and tile features the kernel does not
+ * enable, so no workload using them is offered
+ */
+static void os_xsave_features(void)
+{
+	unsigned long long xcr0 = 0;
+
+	if (cpuid.osxsave) {
+		unsigned int eax, edx;
+
+		asm volatile ("xgetbv" : "=a" (eax), "=d"(edx) : "c"(0));
+		xcr0 = eax | ((unsigned long long)edx) << 32;
+	}
+
+	if ((xcr0 & XCR0_AVX) != XCR0_AVX)
+		cpuid.avx = cpuid.avx2 = cpuid.fma = cpuid.avx2vnni = 0;
+
+	if ((xcr0 & XCR0_AVX512) != XCR0_AVX512)
+		cpuid.avx512f = cpuid.vnni512 = cpuid.avx512_bf16 = cpuid.avx512_fp16 = 0;
+
+	if ((xcr0 & XCR0_AMX) != XCR0_AMX)
+		cpuid.amx_tile = cpuid.amx_int8 = cpuid.amx_bf16 = 0;
 }
 
 static void set_tsc_per_sec(void)
@@ -118,6 +262,21 @@ static void set_tsc_per_sec(void)
 
 	__cpuid(0, max_level, ebx, ecx, edx);
 
+	/* Processor Info and Feature Bits */
+	if (max_level >= 0x1) {
+		unsigned int eax = 0;
+
+		__cpuid(0x1, eax, ebx, ecx, edx);
+		if (ecx & (1 << 12))
+			cpuid.fma = 1;
+		if (ecx & (1 << 20))
+			cpuid.sse4_2 = 1;
+		if (ecx & (1 << 27))
+			cpuid.osxsave = 1;
+		if (ecx & (1 << 28))
+			cpuid.avx = 1;
+	}
+
 	/* Structured Extended Feature Flags Enumeration Leaf */
 	if (max_level >= 0x7) {
 		unsigned int eax_subleaves;
@@ -128,8 +287,22 @@ static void set_tsc_per_sec(void)
 
 		__cpuid_count(0x7, 0, eax_subleaves, ebx, ecx, edx);
 
+		if (ebx & (1 << 5))
+			cpuid.avx2 = 1;
 		if (ebx & (1 << 16))
 			cpuid.avx512f = 1;
+		if (ebx & (1 << 23))
+			cpuid.clflushopt = 1;
+		if (ecx & (1 << 25))
+			cpuid.cldemote = 1;
+		if (edx & (1 << 22))
+			cpuid.amx_bf16 = 1;
+		if (edx & (1 << 23))
+			cpuid.avx512_fp16 = 1;
+		if (edx & (1 << 24))
+			cpuid.amx_tile = 1;
+		if (edx & (1 << 25))
+			cpuid.amx_int8 = 1;
 		if (ecx & (1 << 5))
 			cpuid.tpause = 1;
 		if (ecx & (1 << 11))
@@ -142,11 +315,141 @@ static void set_tsc_per_sec(void)
 			__cpuid_count(0x7, 1, eax, ebx, ecx, edx);
 			if (eax & (1 << 4))
 				cpuid.avx2vnni = 1;
+			if (eax & (1 << 5))
+				cpuid.avx512_bf16 = 1;
+		}
+	}
+
+	os_xsave_features();
+
+	/* Processor Extended State Enumeration Leaf */
+	if (max_level >= 0xd) {
+		unsigned int eax = 0;
+		int i;
+
+		__cpuid_count(0xd, 1, eax, ebx, ecx, edx);
+		if (eax & (1 << 2))
+			cpuid.xgetbv1 = 1;
+
+		for (i = 2; i < 32; i++) {
+			__cpuid_count(0xd, i, eax, ebx, ecx, edx);
+			cpuid.xstate_size[i] = eax;
+		}
+
+		/* XSTATE_BV == 0: xrstor of this image puts components in init state */
+		if (cpuid.xgetbv1) {
+			__cpuid_count(0xd, 0, eax, ebx, ecx, edx);
+			xstate_init_image = aligned_alloc(64, (ebx + 63) & ~63U);
+			if (!xstate_init_image)
+				err(1, "xstate_init_image");
+			memset(xstate_init_image, 0, ebx);
+			*(uint32_t *)(xstate_init_image + 24) = MXCSR_DEFAULT;
 		}
 	}
 
 	if (max_level < 0x15)
 		errx(1, "sorry CPU too old: cpuid level 0x%x < 0x15", max_level);
+
+	/* Time Stamp Counter and Nominal Core Crystal Clock Information Leaf */
+	{
+		unsigned int eax_denominator = 0;
+
+		ebx = ecx = edx = 0;
+		__cpuid(0x15, eax_denominator, ebx, ecx, edx);
+
+		if (eax_denominator && ebx) {
+			if (ecx) {
+				tsc_per_sec = (unsigned long long)ecx * ebx / eax_denominator;
+			} else if (max_level >= 0x16) {
+				unsigned int eax_base_mhz = 0;
+
+				/* crystal not enumerated, the TSC runs at base frequency */
+				__cpuid(0x16, eax_base_mhz, ebx, ecx, edx);
+				tsc_per_sec = eax_base_mhz * 1000000ULL;
+			}
+		}
+	}
+
+	if (tsc_per_sec == 0) {
+		tsc_per_sec = measure_tsc_per_sec();
+		tsc_source = "measured";
+	}
+}
+
+/*
+ * xstate_reset()
+ * return the data components in XFEATURE_MASK_RESETTABLE to init state,
+ * so that XINUSE afterwards reflects only what the workload touches
+ *
+ * noinline: XRSTOR clobbers every vector register, and a call
+ * boundary is where the compiler assumes they are clobbered anyway
+ */
+__attribute__((noinline)) void xstate_reset(void)
+{
+	unsigned long long rfbm = xinuse() & XFEATURE_MASK_RESETTABLE;
+
+	if (!rfbm)
+		return;
+
+	asm volatile ("xrstor64 (%0)"
+		      : : "r" (xstate_init_image), "a"((unsigned int)rfbm),
+		      "d"((unsigned int)(rfbm >> 32))
+		      : "memory");
+}
+
+static __thread unsigned char release_tilecfg[64] __attribute__((aligned(64)));
+
+/*
+ * xstate_release()
+ * what a library can do between bursts: TILERELEASE puts TILECFG and
+ * TILEDATA back in init state, VZEROUPPER the upper halves of YMM0-15
+ * and ZMM0-15; ZMM16-31 stay in use if the workload used them
+ */
+void xstate_release(void)
+{
+	if (cpuid.amx_tile) {
+		/* all zero, palette 0, if the tiles were not configured */
+		asm volatile ("sttilecfg %0" : "=m" (release_tilecfg));
+		asm volatile ("tilerelease" : : : "memory");
+	}
+	if (cpuid.avx)
+		asm volatile ("vzeroupper" : : : "memory");
+}
+
+/*
+ * xstate_reacquire()
+ * after the timed break, put back the tile config xstate_release()
+ * dropped, so the workload goes on as if it had been held; the
+ * tile data is reloaded by the workload's own tile loads.
+ * Like the release, it is outside the break latency but inside run().
+ */
+void xstate_reacquire(void)
+{
+	if (cpuid.amx_tile)
+		asm volatile ("ldtilecfg %0" : : "m" (release_tilecfg));
+}
+
+/*
+ * xstate_footprint()
+ * bytes of XSAVE area the components in xfeatures occupy,
+ * legacy region and header included, in the compacted format
+ */
+unsigned int xstate_footprint(unsigned long long xfeatures)
+{
+	unsigned int bytes = 512 + 64;
+	int i;
+
+	for (i = 2; i < 32; i++)
+		if (xfeatures & (1ULL << i))
+			bytes += cpuid.xstate_size[i];
+
+	return bytes;
+}
+
+void register_workload(struct workload *wp)
+{
+	wp->next = all_workloads;
+	all_workloads = wp;
 }
 
 void register_all_workloads(void)
@@ -160,8 +463,7 @@ void register_all_workloads(void)
 		if (!wp)
 			continue;
 
-		wp->next = all_workloads;
-		all_workloads = wp;
+		register_workload(wp);
 	}
 }
 
@@ -174,6 +476,9 @@ struct work_instance *alloc_new_work_instance(void)
 		err(1, "work_instance");
 
 	wi->workload = all_workloads;	/* default workload is last probed */
+	wi->cpu = -1;
+	wi->alloc_policy = -1;
+	wi->inputs = -1;
 	return wi;
 }
 
@@ -232,17 +537,24 @@ static void initial_wi(void)
 	}
 }
 
-static void deinitialize(void)
+static void free_workers(struct work_instance *wi)
 {
-	struct work_instance *wi;
 	struct work_instance *cur;
 
-	wi = first_worker;
 	while (wi) {
 		cur = wi->next;
+		free(wi->break_hist);
+		free(wi->release_hist);
+		free(wi->trace);
+		free(wi->fpu_counts);
 		free(wi);
 		wi = cur;
 	}
+}
+
+static void deinitialize(void)
+{
+	free_workers(first_worker);
 
 	free(futex_ptr);
 	free(thread_done);
@@ -257,8 +569,21 @@ static void cmdline(int argc, char **argv)
 		{ "help", no_argument, 0, 'h' },
 		{ "work", required_argument, 0, 'w' },
 		{ "repeat", required_argument, 0, 'r' },
+		{ "duration", required_argument, 0, 't' },
 		{ "break_reason", required_argument, 0, 'b' },
 		{"clflush", no_argument, 0, 'f'},
+		{ "cpus", required_argument, 0, 'c' },
+		{ "format", required_argument, 0, 'o' },
+		{ "alloc", required_argument, 0, 'a' },
+		{ "sweep", no_argument, 0, 's' },
+		{ "oversub", required_argument, 0, 'O' },
+		{ "pair", no_argument, 0, 'p' },
+		{ "inputs", required_argument, 0, 'i' },
+		{ "cache", required_argument, 0, 'C' },
+		{ "trace", required_argument, 0, 'T' },
+		{ "rate", required_argument, 0, 'R' },
+		{ "fpu_events", required_argument, 0, 'X' },
+		{ "release", required_argument, 0, 'Z' },
 		{ 0, 0, 0, 0 }
 	};
 
@@ -267,7 +592,7 @@ static void cmdline(int argc, char **argv)
 	if (argc == 1)
 		help();
 
-	while ((opt = getopt_long_only(argc, argv, "h:w:r:b:f",
+	while ((opt = getopt_long_only(argc, argv, "h:w:r:t:b:fc:o:a:sO:pi:C:T:R:X:Z:",
 				       long_options, &option_index)) != -1) {
 		switch (opt) {
 		case 'w':
@@ -277,12 +602,65 @@ static void cmdline(int argc, char **argv)
 		case 'r':
 			repeat_cnt = atoi(optarg);
 			break;
+		case 't':
+			duration_sec = atof(optarg);
+			if (duration_sec <= 0)
+				help();
+			break;
 		case 'b':
 			if (parse_break_cmd(optarg))
 				help();
 			break;
 		case 'f':
-			clfulsh = 1;
+			cache_mode = CACHE_COLD;
+			break;
+		case 'C':
+			if (parse_cache_cmd(optarg))
+				help();
+			break;
+		case 'T':
+			if (parse_trace_cmd(optarg))
+				help();
+			break;
+		case 'X':
+			if (parse_fpu_events_cmd(optarg))
+				help();
+			break;
+		case 'Z':
+			if (parse_release_cmd(optarg))
+				help();
+			break;
+		case 'R':
+			break_hz = atoi(optarg);
+			if (break_hz < 1 || break_hz > BREAK_HZ_MAX)
+				help();
+			break;
+		case 'c':
+			if (parse_cpus_cmd(optarg))
+				help();
+			break;
+		case 'o':
+			if (parse_format_cmd(optarg))
+				help();
+			break;
+		case 'a':
+			if (parse_alloc_cmd(optarg))
+				help();
+			break;
+		case 's':
+			sweep = 1;
+			break;
+		case 'O':
+			oversub = atoi(optarg);
+			if (oversub < 1)
+				help();
+			break;
+		case 'p':
+			pair = 1;
+			break;
+		case 'i':
+			if (parse_inputs_cmd(optarg))
+				help();
 			break;
 		case '?':
 		case 'h':
@@ -291,35 +669,33 @@ static void cmdline(int argc, char **argv)
 		}
 	}
 
-	dump_command(argc, argv);
+	cache_mode_check();
+	if (sweep + !!oversub + pair > 1)
+		errx(1, "-s, -O and -p can not be combined");
+	/* SIGUSR1 arrives mid-iteration, with whatever state is in use then */
+	if (release_mode != RELEASE_HOLD && break_reason == BREAK_BY_SIGNAL)
+		errx(1, "-Z %s: needs a break reason other than signal",
+		     release_mode_names[release_mode]);
+
+	/* keep structured output machine-readable */
+	if (output_format == FORMAT_TEXT) {
+		dump_command(argc, argv);
+		printf("TSC %llu.%03llu MHz (%s)\n", tsc_per_sec / 1000000,
+		       tsc_per_sec / 1000 % 1000, tsc_source);
+	}
 }
 
 static void initialize(int argc, char **argv)
 {
 	set_tsc_per_sec();
 	register_all_workloads();
+	load_plugins();
 	cmdline(argc, argv);
 	initial_wi();
+	bind_workers_to_cpus(first_worker);
 	initial_ptr();
 }
 
-void clflush_range(void *address, size_t size)
-{
-	uintptr_t start = (uintptr_t)address;
-	uintptr_t end = start + size;
-
-	// Align according to the size of the cache line.
-	uintptr_t aligned_start = (start & ~(63UL));
-	uintptr_t aligned_end = (end + 63UL) & ~(63UL);
-
-	for (uintptr_t addr = aligned_start; addr < aligned_end; addr += 64)
-		_mm_clflush((void *)addr);
-
-	// Ensure clearing of unaligned portions.
-	for (uintptr_t addr = aligned_end; addr < end; addr++)
-		_mm_clflush((void *)addr);
-}
-
 static uint64_t do_syscall(uint64_t nr, uint64_t rdi, uint64_t rsi, uint64_t rdx,
 			   uint64_t r10, uint64_t r8, uint64_t r9)
 {
@@ -339,8 +715,29 @@ static uint64_t do_syscall(uint64_t nr, uint64_t rdi, uint64_t rsi, uint64_t rdx
 	return rtn;
 }
 
+static unsigned long long monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static void signal_handler(int32_t signum)
 {
+	/* signal delivery latency, from the timer expiry to here */
+	if (signum == SIGUSR1 && break_hist && signal_next_ns) {
+		unsigned long long now = monotonic_ns();
+		int overrun = timer_getoverrun(signal_timer);
+
+		if (now > signal_next_ns)
+			hist_record(break_hist, (now - signal_next_ns) * tsc_per_sec / 1000000000ULL);
+		/* expiries merged into this signal were never delivered */
+		if (overrun > 0)
+			signal_overruns += overrun;
+		signal_next_ns += (1 + (overrun > 0 ? overrun : 0)) * (1000000000ULL / break_hz);
+	}
+
 	//int32_t current_cpu = sched_getcpu();
 
 	//if (signum == SIGTRAP)
@@ -350,9 +747,102 @@ static void signal_handler(int32_t signum)
 		//printf("Break by signal, current_cpu=%d\n", current_cpu);
 }
 
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/*
+ * signal_timer_create()
+ * for BREAK_BY_SIGNAL, a POSIX timer sends SIGUSR1 to this thread
+ * break_hz times a second, so the rate does not depend on the
+ * number of workers and the main thread stays idle.
+ * It is created before the start barrier, and only armed at go.
+ */
+static void signal_timer_create(void)
+{
+	struct sigevent sev = { 0 };
+
+	sev.sigev_notify = SIGEV_THREAD_ID;
+	sev.sigev_signo = SIGUSR1;
+	sev.sigev_notify_thread_id = syscall(SYS_gettid);
+	if (timer_create(CLOCK_MONOTONIC, &sev, &signal_timer))
+		err(1, "timer_create");
+}
+
+static void signal_timer_start(void)
+{
+	struct itimerspec its = { 0 };
+	unsigned long long period = 1000000000ULL / break_hz;
+
+	signal_overruns = 0;
+	signal_next_ns = monotonic_ns() + period;
+	its.it_value.tv_sec = signal_next_ns / 1000000000ULL;
+	its.it_value.tv_nsec = signal_next_ns % 1000000000ULL;
+	its.it_interval.tv_sec = period / 1000000000ULL;
+	its.it_interval.tv_nsec = period % 1000000000ULL;
+	if (timer_settime(signal_timer, TIMER_ABSTIME, &its, NULL))
+		err(1, "timer_settime");
+}
+
+static void signal_timer_stop(struct work_instance *wi)
+{
+	timer_delete(signal_timer);
+	signal_next_ns = 0;
+	wi->signal_overruns = signal_overruns;
+}
+
+/*
+ * futex_gen_tsc()
+ * the TSC at which futex_gen was bumped to gen, or 0 if its slot has
+ * since been reused, which futex_gen then shows, as a slot is written
+ * only after the bump FUTEX_GEN_SLOTS - 1 before it is published
+ */
+static unsigned long long futex_gen_tsc(uint32_t gen)
+{
+	unsigned long long tsc;
+
+	tsc = __atomic_load_n(&futex_wake_tsc[gen % FUTEX_GEN_SLOTS], __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&futex_gen, __ATOMIC_RELAXED) - gen >= FUTEX_GEN_SLOTS - 1)
+		return 0;
+	return tsc;
+}
+
+/*
+ * thread_break()
+ * enter the kernel by the requested path, and record the
+ * TSC cycles it took in this worker's break_hist
+ */
 void thread_break(int32_t reason, uint32_t thread_idx)
 {
 	struct timespec req;
+	unsigned long long tsc_bgn = 0;
+	uint32_t gen;
+	int released;
+
+	/* BREAK_BY_SIGNAL is recorded asynchronously by signal_handler() */
+	if (reason == BREAK_BY_NOTHING || reason == BREAK_BY_SIGNAL)
+		return;
+
+	released = release_mode == RELEASE_ALWAYS ||
+		   (release_mode == RELEASE_TOGGLE && (break_count++ & 1));
+	if (released)
+		xstate_release();
+
+	/* the state the kernel will have to save for us */
+	if (released)
+		release_xinuse |= xinuse();
+	else
+		break_xinuse |= xinuse();
+
+	/* re-arm the page outside the timed region */
+	if (reason == BREAK_BY_FAULT)
+		madvise((void *)break_page, getpagesize(), MADV_DONTNEED);
+	else if (reason == BREAK_BY_MPROTECT)
+		break_page[0]++;
+
+	if (break_hist)
+		tsc_bgn = rdtsc();
 
 	switch (reason) {
 	case BREAK_BY_YIELD:
@@ -380,8 +870,8 @@ void thread_break(int32_t reason, uint32_t thread_idx)
 		break;
 	case BREAK_BY_SIGNAL:
 		/*
-		 * Do nothing, main thread send SIGUSR1 to sub thread periodically
-		 * Schedule out current thread by signal handling
+		 * Do nothing, signal_timer_start() sends SIGUSR1 to this
+		 * thread periodically, and signal_handler() records it
 		 */
 		break;
 	case BREAK_BY_FUTEX:
@@ -389,66 +879,388 @@ void thread_break(int32_t reason, uint32_t thread_idx)
 		do_syscall(SYS_futex, (uint64_t)&futex_ptr[thread_idx],
 			   FUTEX_WAIT, FUTEX_VAL, 0, 0, 0);
 		break;
+	case BREAK_BY_FUTEX_GEN:
+		/*
+		 * sleep until the next generation, and time from its bump to here,
+		 * even if later bumps came before this worker ran
+		 */
+		gen = __atomic_load_n(&futex_gen, __ATOMIC_ACQUIRE);
+		while (__atomic_load_n(&futex_gen, __ATOMIC_ACQUIRE) == gen)
+			do_syscall(SYS_futex, (uint64_t)&futex_gen, FUTEX_WAIT_PRIVATE, gen, 0, 0, 0);
+		tsc_bgn = futex_gen_tsc(gen + 1);
+		break;
+	case BREAK_BY_MIGRATE:
+		/* pin to the other CPU, the kernel moves us before returning */
+		migrate_next ^= 1;
+		do_syscall(SYS_sched_setaffinity, 0, sizeof(cpu_set_t),
+			   (uint64_t)&migrate_mask[migrate_next], 0, 0, 0);
+		break;
+	case BREAK_BY_FAULT:
+		/* minor fault, the kernel zeroes a fresh page */
+		break_page[0] = 1;
+		break;
+	case BREAK_BY_MPROTECT:
+		/*
+		 * write-protecting a present PTE flushes it from this CPU's TLB,
+		 * and IPIs only the other CPUs running threads of this process,
+		 * i.e. the other workers: one worker alone sends none
+		 */
+		do_syscall(SYS_mprotect, (uint64_t)break_page, getpagesize(), PROT_READ, 0, 0, 0);
+		do_syscall(SYS_mprotect, (uint64_t)break_page, getpagesize(),
+			   PROT_READ | PROT_WRITE, 0, 0, 0);
+		break;
+	case BREAK_BY_MEMBARRIER:
+		/* IPI every CPU running a thread of this process */
+		do_syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0, 0, 0, 0);
+		break;
 	}
+
+	/* a futex_gen bump too far back to time is left out */
+	if (break_hist && tsc_bgn)
+		hist_record(released ? release_hist : break_hist, rdtsc() - tsc_bgn);
+
+	if (released)
+		xstate_reacquire();
 }
 
-static void worker_barrier(void)
+/*
+ * spin_pause()
+ * spin politely, but yield now and then in case the thread
+ * we are waiting for shares this CPU
+ */
+static inline void spin_pause(unsigned int *spins)
 {
-	int i_am_last = 0;
-
-	pthread_mutex_lock(&checkin_mutex);
+	if (++(*spins) % 4096 == 0)
+		sched_yield();
+	else
+		_mm_pause();
+}
 
-	num_checked_in_threads += 1;
-	if (num_checked_in_threads == num_worker_threads)
-		i_am_last = 1;
+/*
+ * worker_barrier()
+ * sense-reversing spin barrier
+ * the last worker to check in publishes go_tsc, a start line
+ * START_DELAY_USEC in the future, before releasing the others
+ */
+#define START_DELAY_USEC 100
+static void worker_barrier(void)
+{
+	unsigned int spins = 0;
 
-	pthread_mutex_unlock(&checkin_mutex);
+	local_sense = !local_sense;
 
-	if (i_am_last) {
-		pthread_cond_broadcast(&checkin_cv);
+	if (__atomic_add_fetch(&num_checked_in_threads, 1, __ATOMIC_ACQ_REL) == num_worker_threads) {
+		num_checked_in_threads = 0;
+		go_tsc = rdtsc() + tsc_per_sec / 1000000 * START_DELAY_USEC;
+		__atomic_store_n(&barrier_sense, local_sense, __ATOMIC_RELEASE);
 	} else {
 		/* wait for all workers to checkin */
-		pthread_mutex_lock(&checkin_mutex);
-		while (num_checked_in_threads < num_worker_threads)
-			if (pthread_cond_wait(&checkin_cv, &checkin_mutex))
-				err(1, "cond_wait: checkin_cv");
-		pthread_mutex_unlock(&checkin_mutex);
+		while (__atomic_load_n(&barrier_sense, __ATOMIC_ACQUIRE) != local_sense)
+			spin_pause(&spins);
+	}
+}
+
+/*
+ * wait_for_go()
+ * return the TSC at which this worker actually starts
+ */
+static unsigned long long wait_for_go(void)
+{
+	unsigned long long tsc;
+
+	while ((tsc = rdtsc()) < go_tsc)
+		_mm_pause();
+
+	return tsc;
+}
+
+static void print_throughput(struct work_instance *wi, unsigned long long cycles)
+{
+	static const char * const prefix[] = { "", "K", "M", "G", "T", "P" };
+	double sec, rate;
+	int i;
+
+	if (cycles == 0)
+		return;
+
+	sec = (double)cycles / tsc_per_sec;
+	rate = wi->work_done / sec;
+	for (i = 0; rate >= 1000 && i < 5; i++)
+		rate /= 1000;
+
+	printf("Thread %d:%s did %llu %s in %.6f sec, %.3f %s%s/s, %.3f %s/cycle.\n",
+	       wi->thread_number, wi->workload->name, wi->work_done,
+	       wi->workload->units, sec, rate, prefix[i], wi->workload->units,
+	       (double)wi->work_done / cycles, wi->workload->units);
+	if (wi->workload->peak_per_cycle)
+		printf("Thread %d:%s %.1f%% of peak %.0f %s/cycle at the TSC rate.\n",
+		       wi->thread_number, wi->workload->name,
+		       (double)wi->work_done / cycles / wi->workload->peak_per_cycle * 100,
+		       wi->workload->peak_per_cycle, wi->workload->units);
+}
+
+/* the clock run() sustained, and how close to peak that was at that clock */
+static void print_core_clock(struct work_instance *wi)
+{
+	double mhz = core_clock_mhz(wi);
+
+	printf("Thread %d:%s core clock %.0f MHz, %.3f TSC GHz\n", wi->thread_number,
+	       wi->workload->name, mhz, tsc_per_sec / 1e9);
+	if (wi->workload->peak_per_cycle)
+		printf("Thread %d:%s %.1f%% of peak %.0f %s/cycle at the core clock.\n",
+		       wi->thread_number, wi->workload->name,
+		       (double)wi->work_done / wi->ctr[CTR_CYCLES] / wi->workload->peak_per_cycle * 100,
+		       wi->workload->peak_per_cycle, wi->workload->units);
+}
+
+/* what else the counter group saw over run() */
+static void print_counters(struct work_instance *wi)
+{
+	int i;
+
+	printf("Thread %d:%s counted", wi->thread_number, wi->workload->name);
+	for (i = 0; i < NUM_COUNTERS; i++)
+		if (counted(wi, i))
+			printf(" %llu %s", wi->ctr[i], counter_names[i]);
+	printf("\n");
+
+	if (counters_ipc(wi))
+		printf("Thread %d:%s IPC %.2f\n", wi->thread_number, wi->workload->name,
+		       counters_ipc(wi));
+	if (counted(wi, CTR_SWITCHES))
+		printf("Thread %d:%s %.1f context switches/sec\n", wi->thread_number,
+		       wi->workload->name, counter_per_sec(wi, CTR_SWITCHES));
+}
+
+/*
+ * break_setup()
+ * per-worker state for the breaks that need it, before the start barrier
+ * migrate ping-pongs between the worker's CPU and the next allowed one
+ */
+static void break_setup(struct work_instance *wi)
+{
+	int home, cpu;
+
+	if (wi->break_reason == BREAK_BY_MIGRATE) {
+		home = wi->cpu >= 0 ? wi->cpu : sched_getcpu();
+		for (cpu = (home + 1) % CPU_SETSIZE; cpu != home; cpu = (cpu + 1) % CPU_SETSIZE)
+			if (CPU_ISSET(cpu, &migrate_allowed))
+				break;
+		CPU_ZERO(&migrate_mask[0]);
+		CPU_SET(home, &migrate_mask[0]);
+		CPU_ZERO(&migrate_mask[1]);
+		CPU_SET(cpu, &migrate_mask[1]);
+		migrate_next = 0;
+	}
+
+	if (wi->break_reason == BREAK_BY_FAULT || wi->break_reason == BREAK_BY_MPROTECT) {
+		break_page = mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE,
+				  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (break_page == MAP_FAILED)
+			err(1, "break page");
+	}
+}
+
+/* undo break_setup(), after run() */
+static void break_cleanup(struct work_instance *wi)
+{
+	if (wi->break_reason == BREAK_BY_MIGRATE)
+		sched_setaffinity(0, sizeof(cpu_set_t), &migrate_mask[0]);
+
+	if (break_page) {
+		munmap((void *)break_page, getpagesize());
+		break_page = NULL;
+	}
+}
+
+/*
+ * pair_stop_others()
+ * under -p, the first sibling to finish ends the other's run too,
+ * so both measure only the time they ran side by side
+ */
+static void pair_stop_others(struct work_instance *wi, unsigned long long endtsc)
+{
+	struct work_instance *o;
+
+	for (o = first_worker; o; o = o->next) {
+		if (o == wi)
+			continue;
+		if (!o->tsc_end || o->tsc_end > endtsc)
+			__atomic_store_n(&o->tsc_end, endtsc, __ATOMIC_RELAXED);
 	}
 }
 
 static void *worker_main(void *arg)
 {
-	// cpu_set_t mask;
-	// CPU_ZERO(&mask);
-	// CPU_SET(1, &mask);
-	// pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
 	struct work_instance *wi = (struct work_instance *)arg;
+	unsigned long long setup_tsc;
 
-	/* initialize data for this worker */
+	free(wi->break_hist);
+	wi->break_hist = hist_alloc();
+	free(wi->release_hist);
+	wi->release_hist = hist_alloc();
+	wi->tid = syscall(SYS_gettid);
+
+	/* initialize data for this worker, timed separately from run() */
+	wi->num_cache_ranges = 0;
+	setup_tsc = rdtsc();
 	if (wi->workload->initialize)
 		wi->workload->initialize(wi);
+	wi->setup_cycles = rdtsc() - setup_tsc;
+	trace_alloc(wi);
+	counters_open(wi);
+	break_setup(wi);
+
+	if (output_format == FORMAT_TEXT) {
+		printf("Thread %d:%s setup took %.6f sec\n", wi->thread_number, wi->workload->name,
+		       (double)wi->setup_cycles / tsc_per_sec);
+		if (wi->alloc_policy >= 0) {
+			char name[64];
+
+			printf("Thread %d:%s buffers are %s\n", wi->thread_number, wi->workload->name,
+			       alloc_policy_name(wi->alloc_policy, name, sizeof(name)));
+		}
+		if (wi->inputs >= 0)
+			printf("Thread %d:%s inputs are %s\n", wi->thread_number, wi->workload->name,
+			       input_mode_name(wi->inputs));
+		if (wi->num_cache_ranges && cache_mode != CACHE_HOT)
+			printf("Thread %d:%s working set is %s before each pass\n",
+			       wi->thread_number, wi->workload->name, cache_mode_name(cache_mode));
+		printf("%s will repeat %u in reason %d\n",
+		       wi->workload->name, wi->repeat, wi->break_reason);
+	}
 
-	worker_barrier();
-
-	printf("%s will repeat %u in reason %d\n",
-	       wi->workload->name, wi->repeat, wi->break_reason);
+	if (wi->break_reason == BREAK_BY_SIGNAL)
+		signal_timer_create();
 
-	unsigned long long bgntsc, endtsc;
+	worker_barrier();
 
-	bgntsc = rdtsc();
+	unsigned long long bgntsc, endtsc, ctr_tsc;
+	struct timespec cpu_bgn, cpu_end;
+
+	/* the XRSTOR is not part of the measurement */
+	xstate_reset();
+	/* every worker times from go_tsc, lateness is reported as skew */
+	wi->start_skew = wait_for_go() - go_tsc;
+	bgntsc = go_tsc;
+	if (duration_sec)
+		wi->tsc_end = bgntsc + duration_sec * tsc_per_sec;
+	break_hist = wi->break_hist;
+	release_hist = wi->release_hist;
+	/* -Z toggle starts every run with a held break */
+	break_count = 0;
+	wi->cache_cycles = 0;
+	wi->trace_start = bgntsc;
+	ctr_tsc = rdtsc();
+	counters_start(wi);
+	ctr_tsc = rdtsc() - ctr_tsc;
+	if (wi->break_reason == BREAK_BY_SIGNAL)
+		signal_timer_start();
+	if (fpu_events)
+		__atomic_store_n(&wi->run_bgn_ns, monotonic_ns(), __ATOMIC_RELEASE);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_bgn);
 	endtsc = wi->workload->run(wi);
-	printf("Thread %d:%s took %llu clock-cycles, end in %llu.\n",
-	       wi->thread_number, wi->workload->name, endtsc - bgntsc, endtsc);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+	if (pair)
+		pair_stop_others(wi, endtsc);
+	if (fpu_events)
+		__atomic_store_n(&wi->run_end_ns, monotonic_ns(), __ATOMIC_RELEASE);
+	if (wi->break_reason == BREAK_BY_SIGNAL)
+		signal_timer_stop(wi);
+	counters_stop(wi);
+	wi->xinuse = break_xinuse | xinuse();
+	wi->release_xinuse = release_xinuse;
+	break_hist = NULL;
+	release_hist = NULL;
+	/* neither cache_state_apply() nor enabling the counters is part of the measurement */
+	wi->cycles = endtsc - bgntsc - wi->cache_cycles - ctr_tsc;
+	wi->last_cpu = sched_getcpu();
+	break_cleanup(wi);
+	wi->cpu_ns = (cpu_end.tv_sec - cpu_bgn.tv_sec) * 1000000000ULL + cpu_end.tv_nsec -
+		     cpu_bgn.tv_nsec;
+	trace_analyze(wi);
+
+	if (output_format == FORMAT_TEXT) {
+		if (cpuid.xgetbv1)
+			printf("Thread %d:%s XINUSE 0x%llx, xstate %u bytes\n",
+			       wi->thread_number, wi->workload->name, wi->xinuse,
+			       xstate_footprint(wi->xinuse));
+		printf("Thread %d:%s on CPU %d took %llu clock-cycles, end in %llu, start skew %llu.\n",
+		       wi->thread_number, wi->workload->name, wi->last_cpu, wi->cycles, endtsc,
+		       wi->start_skew);
+		if (wi->cache_cycles)
+			printf("Thread %d:%s cache %s took %llu clock-cycles, not counted above.\n",
+			       wi->thread_number, wi->workload->name, cache_mode_name(cache_mode),
+			       wi->cache_cycles);
+		if (wi->workload->units)
+			print_throughput(wi, wi->cycles);
+		if (core_clock_mhz(wi))
+			print_core_clock(wi);
+		if (wi->ctr_mask)
+			print_counters(wi);
+		if (wi->break_reason == BREAK_BY_SIGNAL)
+			printf("Thread %d:%s SIGUSR1 at %u Hz, %llu expiries overran\n",
+			       wi->thread_number, wi->workload->name, break_hz, wi->signal_overruns);
+		if (wi->trace_stats.iterations)
+			printf("Thread %d:%s %llu iterations, median %.0f ns, %llu over %.0f ns, max %.0f ns at %llu\n",
+			       wi->thread_number, wi->workload->name, wi->trace_stats.iterations,
+			       wi->trace_stats.median * 1e9 / tsc_per_sec, wi->trace_stats.outliers,
+			       wi->trace_stats.threshold * 1e9 / tsc_per_sec,
+			       wi->trace_stats.max * 1e9 / tsc_per_sec, wi->trace_stats.max_iteration);
+	}
 
 	/* cleanup data for this worker */
 	if (wi->workload->cleanup)
 		wi->workload->cleanup(wi);
 
-	thread_done[wi->thread_number] = true;
+	__atomic_store_n(&thread_done[wi->thread_number], true, __ATOMIC_RELEASE);
 	pthread_exit((void *)0);
 	/* thread exit */
 }
 
+static bool all_threads_done(void)
+{
+	int i;
+
+	for (i = 0; i < num_worker_threads; i++)
+		if (!__atomic_load_n(&thread_done[i], __ATOMIC_ACQUIRE))
+			return false;
+	return true;
+}
+
+/*
+ * futex_gen_wake_all()
+ * every 1/break_hz seconds, bump futex_gen and wake all its waiters
+ * with one FUTEX_WAKE, so the cost to this thread does not grow with
+ * the number of workers, until every worker is done
+ */
+static void futex_gen_wake_all(void)
+{
+	unsigned long long period = 1000000000ULL / break_hz;
+	struct timespec next;
+	uint32_t gen;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!all_threads_done()) {
+		next.tv_nsec += period;
+		while (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		fpu_events_poll(first_worker, 0);
+
+		/* the slot before the generation, and that before the next slot */
+		gen = futex_gen + 1;
+		__atomic_store_n(&futex_wake_tsc[gen % FUTEX_GEN_SLOTS], rdtsc(), __ATOMIC_RELAXED);
+		__atomic_store_n(&futex_gen, gen, __ATOMIC_RELEASE);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		syscall(SYS_futex, &futex_gen, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+	}
+}
+
+/* how often the main thread drains the x86_fpu rings, for -X */
+#define FPU_POLL_MS 100
 static void start_and_wait_for_workers(void)
 {
 	int i;
@@ -457,6 +1269,17 @@ static void start_and_wait_for_workers(void)
 	struct sigaction sigact;
 	bool all_thread_done = false;
 
+	/* where workers may migrate to, before we pin ourselves below */
+	if (break_reason == BREAK_BY_MIGRATE && !CPU_COUNT(&migrate_allowed)) {
+		sched_getaffinity(0, sizeof(migrate_allowed), &migrate_allowed);
+		if (CPU_COUNT(&migrate_allowed) < 2)
+			errx(1, "-b migrate needs two CPUs");
+	}
+
+	if (break_reason == BREAK_BY_MEMBARRIER &&
+	    syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0))
+		err(1, "membarrier register");
+
 	CPU_ZERO(&mask);
 	CPU_SET(0, &mask);
 	pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
@@ -475,6 +1298,12 @@ static void start_and_wait_for_workers(void)
 		sigaction(SIGUSR1, &sigact, NULL);
 	}
 
+	/* threads start with local_sense 0, so may be a re-run under --sweep */
+	barrier_sense = 0;
+	num_checked_in_threads = 0;
+
+	fpu_events_open(first_worker);
+
 	/* create workers */
 	for (wi = first_worker, i = 0; wi; wi = wi->next, i++) {
 		futex_ptr[i] = FUTEX_VAL;
@@ -485,30 +1314,29 @@ static void start_and_wait_for_workers(void)
 		pthread_attr_init(&attr);
 		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 
+		/* bind before initialize() so first-touch lands on the local node */
+		if (wi->cpu >= 0) {
+			cpu_set_t wmask;
+
+			CPU_ZERO(&wmask);
+			CPU_SET(wi->cpu, &wmask);
+			if (pthread_attr_setaffinity_np(&attr, sizeof(wmask), &wmask))
+				err(1, "pthread_attr_setaffinity_np");
+		}
+
 		if (pthread_create(&tid_ptr[i], &attr, &worker_main, wi) != 0)
 			err(1, "pthread_create");
 
 		wi->thread_id = tid_ptr[i];
 	}
 
-	sleep(1);
-
-	if (break_reason == BREAK_BY_SIGNAL) {
-		while (!all_thread_done) {
-			all_thread_done = true;
-			for (i = 0; i < num_worker_threads; i++) {
-				if (!thread_done[i]) {
-					pthread_kill(tid_ptr[i], SIGUSR1);
-					all_thread_done = false;
-					/*
-					 * wait 0.5 second to prevent from
-					 * sending signal too frequently
-					 */
-					usleep(1);
-				}
-			}
-		}
-	}
+	/* futex_gen workers block at their first break, so start waking now */
+	if (break_reason == BREAK_BY_FUTEX_GEN)
+		futex_gen_wake_all();
+	else if (fpu_events)
+		fpu_events_poll(first_worker, 1000);
+	else
+		sleep(1);
 
 	/* Wake up the sub-thread waiting on a futex */
 	if (break_reason == BREAK_BY_FUTEX) {
@@ -522,18 +1350,253 @@ static void start_and_wait_for_workers(void)
 					usleep(1);
 				}
 			}
+			fpu_events_poll(first_worker, 0);
 		}
 	}
 
+	/* keep the x86_fpu rings drained until the workers are done */
+	while (fpu_events && !all_threads_done())
+		fpu_events_poll(first_worker, FPU_POLL_MS);
+
 	/* wait for all workers to join */
 	for (wi = first_worker, i = 0; wi; wi = wi->next, ++i)
 		if (pthread_join(tid_ptr[i], NULL) != 0)
 			err(0, "thread %ld failed to join\n", wi->thread_id);
+	fpu_events_close(first_worker);
+}
+
+/*
+ * run_sweep()
+ * rerun every worker at each working-set size from sweep_sizes(),
+ * then report throughput versus size
+ */
+#define SWEEP_DEFAULT_SEC 0.2
+static void run_sweep(void)
+{
+	struct cache_sizes cs;
+	struct work_instance *wi;
+	unsigned int *sizes;
+	int num, i;
+
+	if (read_cache_sizes(&cs))
+		errx(1, "sweep: can not read cache sizes from /sys/devices/system/cpu/cpu0/cache");
+
+	/* without -r or -t, every point would run forever */
+	if (!duration_sec && !repeat_cnt)
+		duration_sec = SWEEP_DEFAULT_SEC;
+
+	num = sweep_sizes(&cs, &sizes);
+	for (i = 0; i < num; i++) {
+		for (wi = first_worker; wi; wi = wi->next)
+			wi->wi_bytes = sizes[i];
+		if (output_format == FORMAT_TEXT)
+			printf("sweep: working set %u bytes\n", sizes[i]);
+		start_and_wait_for_workers();
+		sweep_record(first_worker, sizes[i]);
+	}
+	free(sizes);
+
+	report_sweep(&cs);
+}
+
+/* long enough for many scheduler time slices */
+#define OVERSUB_DEFAULT_SEC 1
+/* small enough for the threads sharing a CPU to share its L2 too */
+#define OVERSUB_BYTES (256 * 1024)
+
+/* make the list at first the workers of the next run */
+static void use_workers(struct work_instance *first)
+{
+	struct work_instance *wi;
+
+	first_worker = first;
+	num_worker_threads = 0;
+	for (wi = first; wi; wi = wi->next) {
+		last_worker = wi;
+		num_worker_threads++;
+	}
+
+	free(futex_ptr);
+	free(thread_done);
+	free(tid_ptr);
+	initial_ptr();
+}
+
+/* a worker like mix, on cpu */
+static struct work_instance *oversub_worker(struct work_instance *mix, int cpu)
+{
+	struct work_instance *wi = alloc_new_work_instance();
+
+	wi->workload = mix->workload;
+	wi->break_reason = mix->break_reason;
+	wi->repeat = mix->repeat;
+	wi->wi_bytes = OVERSUB_BYTES;
+	wi->cpu = cpu;
+	return wi;
+}
+
+/*
+ * run_oversub()
+ * run each workload of the -w mix alone on the first -c CPU,
+ * then oversub threads of the mix on every -c CPU at once,
+ * and report what sharing a CPU cost each thread
+ */
+static void run_oversub(void)
+{
+	struct work_instance *mix = first_worker;
+	struct work_instance *wi, *list = NULL, **tail = &list;
+	int *cpus, num_cpus, num_mix = 0;
+	int c, k;
+
+	num_cpus = policy_cpus(&cpus);
+	if (!num_cpus)
+		errx(1, "oversub: needs the CPUs to share, see -c");
+
+	/* without -r or -t, every run would run forever */
+	if (!duration_sec && !repeat_cnt)
+		duration_sec = OVERSUB_DEFAULT_SEC;
+
+	for (wi = mix; wi; wi = wi->next) {
+		struct work_instance *solo;
+
+		num_mix++;
+		if (oversub_solo_done(wi->workload))
+			continue;
+		if (output_format == FORMAT_TEXT)
+			printf("oversub: %s alone on CPU %d\n", wi->workload->name, cpus[0]);
+		solo = oversub_worker(wi, cpus[0]);
+		use_workers(solo);
+		start_and_wait_for_workers();
+		oversub_record_solo(solo);
+		free_workers(solo);
+	}
+
+	/* CPU c runs mix entries c * oversub ... c * oversub + oversub - 1, wrapping */
+	for (c = 0; c < num_cpus; c++) {
+		for (k = 0; k < oversub; k++) {
+			int m = (c * oversub + k) % num_mix;
+
+			for (wi = mix; m--; wi = wi->next)
+				;
+			*tail = oversub_worker(wi, cpus[c]);
+			tail = &(*tail)->next;
+		}
+	}
+	free_workers(mix);
+	free(cpus);
+
+	if (output_format == FORMAT_TEXT)
+		printf("oversub: %d threads on each of %d CPUs\n", oversub, num_cpus);
+	use_workers(list);
+	start_and_wait_for_workers();
+
+	report_oversub(first_worker, oversub, num_cpus);
+}
+
+/* long enough for the siblings to settle at their shared clock */
+#define PAIR_DEFAULT_SEC 1
+
+/* a worker running wp on cpu */
+static struct work_instance *pair_worker(struct workload *wp, int cpu)
+{
+	struct work_instance *wi = alloc_new_work_instance();
+
+	wi->workload = wp;
+	wi->break_reason = break_reason;
+	wi->repeat = repeat_cnt;
+	wi->wi_bytes = SIZE_1GB;
+	wi->cpu = cpu;
+	return wi;
+}
+
+/* replace the workers of the last run with list, and run them */
+static void pair_run(struct work_instance *list)
+{
+	free_workers(first_worker);
+	use_workers(list);
+	start_and_wait_for_workers();
+}
+
+/*
+ * run_pair()
+ * run each workload alone on one SMT thread of a core, then every
+ * pair of them on its two threads, for the retention matrix
+ */
+static void run_pair(void)
+{
+	struct workload **wl, *wp;
+	struct work_instance *wi, *a;
+	int cpus[2];
+	int num_wl = 0;
+	int i, j;
+
+	if (smt_sibling_pair(cpus))
+		errx(1, "pair: no two available CPUs are SMT siblings in thread_siblings_list");
+
+	/* the distinct -w workloads, or every registered one */
+	for (wp = all_workloads; wp; wp = wp->next)
+		num_wl++;
+	wl = malloc(sizeof(struct workload *) * num_wl);
+	if (!wl)
+		err(1, "pair");
+	num_wl = 0;
+	if (first_worker) {
+		for (wi = first_worker; wi; wi = wi->next) {
+			for (i = 0; i < num_wl; i++)
+				if (wl[i] == wi->workload)
+					break;
+			if (i == num_wl)
+				wl[num_wl++] = wi->workload;
+		}
+	} else {
+		for (wp = all_workloads; wp; wp = wp->next)
+			wl[num_wl++] = wp;
+	}
+
+	/* without -r or -t, every run would run forever */
+	if (!duration_sec && !repeat_cnt)
+		duration_sec = PAIR_DEFAULT_SEC;
+
+	for (i = 0; i < num_wl; i++) {
+		if (output_format == FORMAT_TEXT)
+			printf("pair: %s alone on CPU %d\n", wl[i]->name, cpus[0]);
+		pair_run(pair_worker(wl[i], cpus[0]));
+		pair_record_solo(first_worker);
+	}
+
+	/* the diagonal is a workload against a copy of itself */
+	for (i = 0; i < num_wl; i++) {
+		for (j = i; j < num_wl; j++) {
+			if (output_format == FORMAT_TEXT)
+				printf("pair: %s on CPU %d, %s on CPU %d\n",
+				       wl[i]->name, cpus[0], wl[j]->name, cpus[1]);
+			a = pair_worker(wl[i], cpus[0]);
+			a->next = pair_worker(wl[j], cpus[1]);
+			pair_run(a);
+			pair_record(a, a->next);
+			pair_record(a->next, a);
+		}
+	}
+	free(wl);
+
+	report_pair(cpus);
 }
 
 int main(int argc, char **argv)
 {
 	initialize(argc, argv);
-	start_and_wait_for_workers();
+	if (sweep) {
+		run_sweep();
+	} else if (oversub) {
+		run_oversub();
+	} else if (pair) {
+		run_pair();
+	} else {
+		start_and_wait_for_workers();
+		report_results(first_worker);
+	}
+	/* under --sweep, the rings hold the last size */
+	trace_dump(first_worker);
+	fpu_events_finish();
 	deinitialize();
 }
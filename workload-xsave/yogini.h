@@ -12,10 +12,78 @@
 #include <string.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <stdint.h>
 
-#ifndef CMAKE_FLAG
-#define CMAKE_FLAG 1
-#endif
+enum {
+	BREAK_BY_NOTHING = 0,
+	BREAK_BY_YIELD = 1,
+	BREAK_BY_SLEEP,
+	BREAK_BY_TRAP,
+	BREAK_BY_SIGNAL,
+	BREAK_BY_FUTEX,
+	BREAK_BY_FUTEX_GEN,
+	BREAK_BY_MIGRATE,
+	BREAK_BY_FAULT,
+	BREAK_BY_MPROTECT,
+	BREAK_BY_MEMBARRIER,
+	BREAK_REASON_MAX = BREAK_BY_MEMBARRIER
+};
+
+extern char *break_reason_names[];
+
+/* -b signal timer rate per worker, -b futex_gen wake rate */
+#define BREAK_HZ_DEFAULT	1000
+#define BREAK_HZ_MAX		1000000
+extern unsigned int break_hz;
+
+/* -Z: the vector and tile state a worker holds across thread_break() */
+enum {
+	RELEASE_HOLD = 0,	/* keep it, as a library that never releases would */
+	RELEASE_ALWAYS,		/* TILERELEASE and VZEROUPPER before every break */
+	RELEASE_TOGGLE,		/* before every other break, to compare in one run */
+	RELEASE_MAX = RELEASE_TOGGLE
+};
+
+extern int release_mode;
+extern char *release_mode_names[];
+
+#define CACHE_MAX_RANGES	8
+
+struct cache_range {
+	void *ptr;
+	size_t bytes;
+};
+
+/* per-iteration TSC ring of each worker, see trace.c */
+#define TRACE_ENTRIES	(1 << 16)
+
+struct trace_stats {
+	unsigned long long iterations;	/* analyzed, at most TRACE_ENTRIES */
+	unsigned long long median;	/* TSC cycles per iteration */
+	unsigned long long threshold;	/* iterations longer than this are outliers */
+	unsigned long long outliers;
+	unsigned long long max;
+	unsigned long long max_iteration;
+};
+
+/* perf_event counters of each worker, see counters.c */
+enum {
+	CTR_CYCLES,
+	CTR_INSTRUCTIONS,
+	CTR_REF_CYCLES,
+	CTR_SWITCHES,
+	CTR_FP_ARITH,
+	CTR_AMX_OPS,
+	NUM_COUNTERS
+};
+
+/* x86_fpu tracepoint samples of one event and xfeatures mask, see fpu_events.c */
+#define FPU_EVENT_NAME	48
+struct fpu_count {
+	int event;
+	unsigned long long xfeatures;
+	unsigned long long count;
+};
 
 struct work_instance {
 	struct work_instance *next;
@@ -26,6 +94,39 @@ struct work_instance {
 	unsigned int repeat;
 	unsigned int wi_bytes;
 	int break_reason;
+	int cpu;		/* CPU this worker is bound to, -1 if unbound */
+	unsigned long long tsc_end;	/* run() stops here, 0 for no time limit */
+	unsigned long long work_done;	/* in units of workload->units */
+	unsigned long long cycles;	/* TSC cycles spent in run() */
+	unsigned long long cpu_ns;	/* CPU time of the thread in run() */
+	unsigned long long start_skew;	/* TSC cycles this worker started after go_tsc */
+	int last_cpu;		/* CPU the worker was on when run() returned */
+	struct histogram *break_hist;	/* TSC cycles spent in each thread_break() */
+	struct histogram *release_hist;	/* the same, for breaks after xstate_release() */
+	int alloc_policy;	/* used by alloc_work_buffer(), -1 if none */
+	unsigned long long xinuse;	/* XINUSE seen at thread_break() and run() exit */
+	unsigned long long release_xinuse;	/* XINUSE seen at breaks after xstate_release() */
+	unsigned long long setup_cycles;	/* TSC cycles spent in initialize() */
+	int inputs;		/* INPUTS_* used by get_input_buffer(), -1 if none */
+	struct cache_range cache_ranges[CACHE_MAX_RANGES];	/* see cache_state_add() */
+	int num_cache_ranges;
+	unsigned long long cache_cycles;	/* TSC cycles in cache_state_apply(), untimed */
+	unsigned long long *trace;	/* TRACE_ENTRIES iteration end TSCs, NULL without -T */
+	unsigned long long trace_count;	/* iterations recorded, may exceed TRACE_ENTRIES */
+	unsigned long long trace_start;	/* TSC the first iteration started */
+	struct trace_stats trace_stats;
+	int ctr_fd[NUM_COUNTERS];	/* perf_event fds, -1 if unavailable */
+	int ctr_group;		/* group leader fd, -1 if none opened */
+	unsigned int ctr_mask;	/* 1 << CTR_* for each counter read */
+	unsigned long long ctr[NUM_COUNTERS];	/* counts over run(), see counters.c */
+	int tid;		/* gettid() of the worker */
+	unsigned long long run_bgn_ns;	/* CLOCK_MONOTONIC around run(), for -X */
+	unsigned long long run_end_ns;
+	struct fpu_count *fpu_counts;	/* x86_fpu samples in run(), NULL without -X */
+	int num_fpu_counts;
+	unsigned long long xsaves;	/* x86_fpu samples that are an XSAVE */
+	unsigned long long xrstors;	/* and an XRSTOR */
+	unsigned long long signal_overruns;	/* timer expiries merged, -b signal */
 };
 
 struct workload {
@@ -33,11 +134,39 @@ struct workload {
 	int (*initialize)(struct work_instance *wi);
 	int (*cleanup)(struct work_instance *wi);
 	unsigned long long (*run)(struct work_instance *wi);
+	char *units;		/* what run() counts in wi->work_done */
+	double peak_per_cycle;	/* theoretical units per core clock, 0 if unknown */
+	int alloc_policy;	/* ALLOC_*, see alloc_work_buffer() */
 
 	struct workload *next;
 };
 
 extern struct workload *all_workloads;
+void register_workload(struct workload *wp);
+
+/*
+ * plugin ABI, see plugin.c
+ * bump YOGINI_PLUGIN_ABI on any change to the layout of the structures
+ * or the meaning of the functions here that a workload uses.
+ * plugin.c does not build until the sizes below match the structures,
+ * so a change to either is a reminder to bump the ABI with them.
+ */
+#define YOGINI_PLUGIN_ABI	2
+#define YOGINI_WORKLOAD_SIZE	64
+#define YOGINI_WORK_INSTANCE_SIZE	520
+#ifndef YOGINI_PLUGIN_DIR
+#define YOGINI_PLUGIN_DIR	"/usr/lib/yogini"
+#endif
+#define YOGINI_PLUGIN(register_routine)					\
+	unsigned int yogini_plugin_abi = YOGINI_PLUGIN_ABI;		\
+	size_t yogini_plugin_sizes[] = {				\
+		sizeof(struct workload), sizeof(struct work_instance)	\
+	};								\
+	struct workload *yogini_plugin_register(void)			\
+	{								\
+		return register_routine();				\
+	}
+void load_plugins(void);
 
 extern struct workload *register_GETCPU(void);
 extern struct workload *register_RDTSC(void);
@@ -46,33 +175,54 @@ extern struct workload *register_AVX2(void);
 extern struct workload *register_AVX512(void);
 extern struct workload *register_VNNI512(void);
 extern struct workload *register_VNNI(void);
+extern struct workload *register_AVX512_BF16(void);
+extern struct workload *register_AVX512_FP16(void);
 extern struct workload *register_DOTPROD(void);
 extern struct workload *register_PAUSE(void);
 extern struct workload *register_TPAUSE(void);
 extern struct workload *register_UMWAIT(void);
-extern struct workload *register_FP64(void);
+extern struct workload *register_FP64_SSE(void);
+extern struct workload *register_FP64_AVX2(void);
+extern struct workload *register_FP64_AVX512(void);
+extern struct workload *register_FP32_SSE(void);
+extern struct workload *register_FP32_AVX2(void);
+extern struct workload *register_FP32_AVX512(void);
 extern struct workload *register_SSE(void);
 extern struct workload *register_MEM(void);
+extern struct workload *register_MEM_MOVSB(void);
+extern struct workload *register_MEM_AVX2(void);
+extern struct workload *register_MEM_PREFETCH(void);
+extern struct workload *register_MEM_AVX512(void);
+extern struct workload *register_MEM_NT(void);
+extern struct workload *register_MEM_NT512(void);
+extern struct workload *register_MEM_CHASE(void);
 extern struct workload *register_memcpy(void);
 extern struct workload *register_AMX(void);
+extern struct workload *register_AMX_GEMM_INT8(void);
+extern struct workload *register_AMX_GEMM_BF16(void);
 
 extern unsigned int SIZE_1GB;
+extern unsigned long long tsc_per_sec;
+extern double duration_sec;
 
 #ifdef YOGINI_MAIN
+/* every routine checks CPUID at run time, and returns NULL if it can not run */
 struct workload *(*all_register_routines[]) () = {
-#if MAVX_ENABLED || CMAKE_FLAG
 	register_AVX,
-#endif
-#if MAVX2_ENABLED || CMAKE_FLAG
 	register_AVX2,
-#endif
-#if MAVX512F_ENABLED || CMAKE_FLAG
+#if __GNUC__ >= 11
 	register_AVX512,
 #endif
-#if MVNNI512_ENABLED || CMAKE_FLAG
+#if __GNUC__ >= 9
 	register_VNNI512,
 #endif
-#if MVNNI_ENABLED || CMAKE_FLAG
+#if __GNUC__ >= 11
+	register_AVX512_BF16,
+#endif
+#if __GNUC__ >= 12
+	register_AVX512_FP16,
+#endif
+#if __GNUC__ >= 11
 	register_VNNI,
 #endif
 	register_DOTPROD,
@@ -82,14 +232,25 @@ struct workload *(*all_register_routines[]) () = {
 	register_UMWAIT,
 #endif
 	register_RDTSC,
-#if MSSE_ENABLED || CMAKE_FLAG
+	register_FP64_SSE,
+	register_FP64_AVX2,
+	register_FP64_AVX512,
+	register_FP32_SSE,
+	register_FP32_AVX2,
+	register_FP32_AVX512,
 	register_SSE,
-#endif
 	register_MEM,
+	register_MEM_MOVSB,
+	register_MEM_AVX2,
+	register_MEM_PREFETCH,
+	register_MEM_AVX512,
+	register_MEM_NT,
+	register_MEM_NT512,
+	register_MEM_CHASE,
 	register_memcpy,
-#if MAMX_ENABLED || CMAKE_FLAG
 	register_AMX,
-#endif
+	register_AMX_GEMM_INT8,
+	register_AMX_GEMM_BF16,
 	NULL
 };
 #endif
@@ -114,14 +275,216 @@ static inline unsigned long long rdtsc(void)
 	return low | ((unsigned long long)high) << 32;
 }
 
-void clflush_range(void *address, size_t size);
-extern int clfulsh;
+/* stamp the end of an iteration in wi's trace ring, if -T */
+static inline void trace_record(struct work_instance *wi)
+{
+	if (wi->trace)
+		wi->trace[wi->trace_count++ & (TRACE_ENTRIES - 1)] = rdtsc();
+}
+
 struct cpuid {
+	unsigned int sse4_2;
+	unsigned int osxsave;		/* XGETBV(0) reads XCR0 */
+	unsigned int avx;
+	unsigned int fma;
+	unsigned int avx2;
 	unsigned int avx512f;
 	unsigned int vnni512;
 	unsigned int avx2vnni;
+	unsigned int avx512_bf16;
+	unsigned int avx512_fp16;
 	unsigned int tpause;
+	unsigned int amx_tile;
+	unsigned int amx_bf16;
+	unsigned int amx_int8;
+	unsigned int clflushopt;
+	unsigned int cldemote;
+	unsigned int xgetbv1;		/* XGETBV(1) reports XINUSE */
+	unsigned int xstate_size[32];	/* CPUID.(0xD, i).EAX */
 };
 
 extern struct cpuid cpuid;
+
+/*
+ * xinuse()
+ * XSAVE components not in their init state, 0 if XGETBV(1) is unsupported
+ */
+static inline unsigned long long xinuse(void)
+{
+	unsigned int eax, edx;
+
+	if (!cpuid.xgetbv1)
+		return 0;
+
+	asm volatile ("xgetbv" : "=a" (eax), "=d"(edx) : "c"(1));
+
+	return eax | ((unsigned long long)edx) << 32;
+}
+
+void xstate_reset(void);
+void xstate_release(void);
+void xstate_reacquire(void);
+unsigned int xstate_footprint(unsigned long long xfeatures);
+
+struct cpu_topology {
+	int cpu;
+	int package;
+	int core;
+	int core_idx;		/* rank of this core within its package */
+	int smt;		/* rank of this CPU within its core */
+};
+
+extern struct cpu_topology *cpu_topo;
+extern int topo_num_cpus;
+
+#define HIST_PRECISION_BITS	6
+#define HIST_BUCKETS		((66 - HIST_PRECISION_BITS) << (HIST_PRECISION_BITS - 1))
+
+struct histogram {
+	unsigned long long count;
+	unsigned long long sum;
+	unsigned long long max;
+	unsigned long long buckets[HIST_BUCKETS];
+};
+
+struct histogram *hist_alloc(void);
+void hist_record(struct histogram *h, unsigned long long v);
+void hist_merge(struct histogram *dst, struct histogram *src);
+unsigned long long hist_percentile(struct histogram *h, double pct);
+
+enum {
+	ALLOC_PAGE_DEFAULT = 0,	/* let the kernel decide, as malloc(3) does */
+	ALLOC_PAGE_4K,		/* MADV_NOHUGEPAGE */
+	ALLOC_PAGE_THP,		/* MADV_HUGEPAGE */
+	ALLOC_PAGE_2M,		/* MAP_HUGETLB */
+	ALLOC_PAGE_1G,		/* MAP_HUGETLB */
+};
+#define ALLOC_PAGE_MASK		0x7
+#define ALLOC_NUMA_LOCAL	(1 << 3)
+#define ALLOC_NUMA_INTERLEAVE	(1 << 4)
+#define ALLOC_POPULATE		(1 << 5)
+
+int parse_alloc_cmd(char *input_string);
+char *alloc_policy_name(int policy, char *buf, int len);
+void *alloc_policy_buffer(char *name, size_t bytes, int policy);
+void free_policy_buffer(void *ptr, size_t bytes, int policy);
+void *alloc_work_buffer(struct work_instance *wi, size_t bytes);
+void free_work_buffer(struct work_instance *wi, void *ptr, size_t bytes);
+
+enum {
+	FORMAT_TEXT = 0,
+	FORMAT_JSON,
+	FORMAT_CSV,
+};
+
+struct cache_sizes {
+	unsigned long l1d;
+	unsigned long l2;
+	unsigned long llc;
+};
+
+extern int output_format;
+int parse_format_cmd(char *input_string);
+void report_results(struct work_instance *first);
+void sweep_record(struct work_instance *first, unsigned int bytes);
+void report_sweep(struct cache_sizes *cs);
+int oversub_solo_done(struct workload *wp);
+void oversub_record_solo(struct work_instance *wi);
+void report_oversub(struct work_instance *first, int per_cpu, int num_cpus);
+void pair_record_solo(struct work_instance *wi);
+void pair_record(struct work_instance *wi, struct work_instance *sibling);
+void report_pair(int pair[2]);
+
+int read_cache_sizes(struct cache_sizes *cs);
+int sweep_sizes(struct cache_sizes *cs, unsigned int **sizes);
+
+/* murmur3 fmix32, a bijection on 32-bit words */
+#define RNG_MIX_C1	0x85ebca6b
+#define RNG_MIX_C2	0xc2b2ae35
+static inline uint32_t rng_mix32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= RNG_MIX_C1;
+	x ^= x >> 13;
+	x *= RNG_MIX_C2;
+	x ^= x >> 16;
+	return x;
+}
+
+/* word counter of the random stream selected by key, see rng_fill() */
+static inline uint32_t rng_u32(uint32_t key, uint32_t counter)
+{
+	return rng_mix32(rng_mix32(counter ^ key) + key);
+}
+
+/* a separate stream for each buffer of each worker */
+#define RNG_KEY(wi, buffer)	(((uint32_t)(wi)->thread_number << 8) | (buffer))
+
+void rng_fill(void *buf, size_t bytes, uint32_t key);
+void rng_fill_bf16(void *buf, size_t bytes, uint32_t key);
+void rng_fill_fp16(void *buf, size_t bytes, uint32_t key);
+void rng_fill_fp32(void *buf, size_t bytes, uint32_t key);
+
+enum {
+	INPUTS_PRIVATE = 0,	/* each worker fills its own */
+	INPUTS_SHARED,		/* one read-only copy per workload */
+	INPUTS_NODE,		/* one read-only copy per workload per NUMA node */
+};
+
+typedef void (*input_fill_fn)(void *buf, size_t bytes, uint32_t key);
+
+extern int input_mode;
+int parse_inputs_cmd(char *input_string);
+char *input_mode_name(int mode);
+void *get_input_buffer(struct work_instance *wi, int buffer, size_t bytes, input_fill_fn fill);
+void put_input_buffer(struct work_instance *wi, void *ptr);
+
+enum {
+	CACHE_HOT = 0,		/* leave the working set cached */
+	CACHE_LLC,		/* CLDEMOTE it to the LLC before each pass */
+	CACHE_COLD,		/* flush it to memory before each pass */
+};
+
+extern int cache_mode;
+int parse_cache_cmd(char *input_string);
+char *cache_mode_name(int mode);
+void cache_mode_check(void);
+void cache_state_add(struct work_instance *wi, void *ptr, size_t bytes);
+void cache_state_apply(struct work_instance *wi);
+
+int perf_open(unsigned int type, unsigned long long config, int group);
+int core_clock_open(int group);
+int ref_clock_open(int group);
+double core_clock_mhz(struct work_instance *wi);
+
+extern char *counter_names[NUM_COUNTERS];
+void counters_open(struct work_instance *wi);
+void counters_start(struct work_instance *wi);
+void counters_stop(struct work_instance *wi);
+int counted(struct work_instance *wi, int ctr);
+double counters_ipc(struct work_instance *wi);
+double counter_per_sec(struct work_instance *wi, int ctr);
+
+extern int fpu_events;
+extern char *fpu_events_file;
+extern unsigned long long fpu_events_lost;
+int parse_fpu_events_cmd(char *input_string);
+void fpu_events_open(struct work_instance *first);
+void fpu_events_poll(struct work_instance *first, int timeout_ms);
+void fpu_events_close(struct work_instance *first);
+void fpu_events_finish(void);
+char *fpu_event_name(int event);
+
+extern char *trace_file;
+int parse_trace_cmd(char *input_string);
+void trace_alloc(struct work_instance *wi);
+void trace_analyze(struct work_instance *wi);
+void trace_dump(struct work_instance *first);
+
+int parse_cpulist(const char *str, int **cpus);
+void discover_cpu_topology(void);
+int parse_cpus_cmd(char *input_string);
+int policy_cpus(int **cpus);
+int smt_sibling_pair(int pair[2]);
+void bind_workers_to_cpus(struct work_instance *first);
 #endif